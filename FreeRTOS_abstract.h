@@ -7,14 +7,23 @@
 #include "queue.h"
 #include "semphr.h"
 #include "timers.h"
+#include "event_groups.h"
 #include "croutine.h"
 #include "FreeRTOSConfig.h"
 
 /* LIBC */
 #include <stdint.h>
+#include <stdio.h>
 #include <string.h>
+#include <atomic>
+#include <cstddef>
+#include <new>
 #include <type_traits>
 #include <utility>
+#include <variant>
+#if defined(__cpp_impl_coroutine)
+#include <coroutine>
+#endif
 
 /**
  * @Note
@@ -40,8 +49,222 @@
 #define FREERTOS_DEFAULT_TASK_STACK_SIZE		configMINIMAL_STACK_SIZE
 #endif
 
+/**
+ * Size in bytes of storage inside Task for a callable and its captures.
+ */
+#ifndef FREERTOS_TASK_FUNCTOR_SIZE
+#define FREERTOS_TASK_FUNCTOR_SIZE			(4 * sizeof(void *))
+#endif
+
 #define WAIT_MAX					portMAX_DELAY
 
+/**
+ * Size in bytes of callable storage in every job of ThreadPool.
+ */
+#ifndef FREERTOS_JOB_SIZE
+#define FREERTOS_JOB_SIZE				(4 * sizeof(void *))
+#endif
+
+/**
+ * Size in bytes of storage inside Promise for the Future::Then() callable.
+ */
+#ifndef FREERTOS_THEN_SIZE
+#define FREERTOS_THEN_SIZE				(4 * sizeof(void *))
+#endif
+
+/**
+ * Task notification index used to wake tasks blocked on ConditionVariable
+ * and other primitives built on WaitList. Must not be 0, the index used by
+ * Task::Notify() and the notification semaphores by default, so at least two
+ * notification array entries are required.
+ */
+#ifndef FREERTOS_SYNC_NOTIFY_INDEX
+#define FREERTOS_SYNC_NOTIFY_INDEX		(configTASK_NOTIFICATION_ARRAY_ENTRIES - 1)
+#endif
+
+/**
+ * FREERTOS_SYNC_NOTIFY is 1 when a notification index other than 0 exists.
+ * WaitList and everything built on it (ConditionVariable, Latch, Barrier,
+ * Promise, Future, Task::Async, ThreadPool, AsyncExecutor) are only
+ * available then, other classes work with a single notification entry.
+ */
+#ifndef FREERTOS_SYNC_NOTIFY
+#if (configUSE_TASK_NOTIFICATIONS == 1) && \
+    defined(configTASK_NOTIFICATION_ARRAY_ENTRIES) && \
+    (configTASK_NOTIFICATION_ARRAY_ENTRIES > 1)
+#define FREERTOS_SYNC_NOTIFY			1
+#else
+#define FREERTOS_SYNC_NOTIFY			0
+#endif
+#endif
+
+/**
+ * Longest time in [ms] Mutex::Lock() with a stop token blocks before checking
+ * the token again. Bounds a stop requested just before the lock blocks, or
+ * any stop when INCLUDE_xTaskAbortDelay is not enabled.
+ */
+#ifndef FREERTOS_STOP_POLL_MS
+#define FREERTOS_STOP_POLL_MS			100
+#endif
+
+/**
+ * Set FREERTOS_LOCK_PROFILING to 1 to collect contention statistics for every
+ * Mutex and semaphore. When disabled, no code or data is added.
+ */
+#ifndef FREERTOS_LOCK_PROFILING
+#define FREERTOS_LOCK_PROFILING			0
+#endif
+
+/**
+ * Set FREERTOS_LOCK_DEBUG to 1 to validate the order in which tasks take
+ * mutexes. Lock order inversions are reported before they deadlock.
+ */
+#ifndef FREERTOS_LOCK_DEBUG
+#define FREERTOS_LOCK_DEBUG			0
+#endif
+
+#ifndef FREERTOS_LOCK_DEBUG_MAX_LOCKS
+#define FREERTOS_LOCK_DEBUG_MAX_LOCKS		32
+#endif
+
+#ifndef FREERTOS_LOCK_DEBUG_MAX_TASKS
+#define FREERTOS_LOCK_DEBUG_MAX_TASKS		16
+#endif
+
+/**
+ * Set FREERTOS_BLOCKING_TRACE to 1 to record which task blocks on which
+ * Mutex, semaphore or Queue, and who it is waiting for.
+ */
+#ifndef FREERTOS_BLOCKING_TRACE
+#define FREERTOS_BLOCKING_TRACE			0
+#endif
+
+#ifndef FREERTOS_BLOCKING_TRACE_MAX_TASKS
+#define FREERTOS_BLOCKING_TRACE_MAX_TASKS	16
+#endif
+
+#ifndef FREERTOS_BLOCKING_TRACE_DEPTH
+#define FREERTOS_BLOCKING_TRACE_DEPTH		4
+#endif
+
+#ifndef FREERTOS_BLOCKING_TRACE_EVENTS
+#define FREERTOS_BLOCKING_TRACE_EVENTS		32
+#endif
+
+/**
+ * Thread local storage pointer holding the id of the task's blocking record.
+ */
+#ifndef FREERTOS_BLOCKING_TRACE_TLS_INDEX
+#define FREERTOS_BLOCKING_TRACE_TLS_INDEX	(configNUM_THREAD_LOCAL_STORAGE_POINTERS - 1 - FREERTOS_CONTEXT_SWITCH_COUNT)
+#endif
+
+/**
+ * Set FREERTOS_STACK_MONITOR to 1 to register every Task in StackMonitor,
+ * which samples stack usage and recommends stack sizes.
+ */
+#ifndef FREERTOS_STACK_MONITOR
+#define FREERTOS_STACK_MONITOR			0
+#endif
+
+/**
+ * Safety margin in percent added on top of the measured stack usage.
+ */
+#ifndef FREERTOS_STACK_MARGIN
+#define FREERTOS_STACK_MARGIN			25
+#endif
+
+/**
+ * Recommended stack sizes are rounded up to a multiple of this many words.
+ */
+#ifndef FREERTOS_STACK_ROUND
+#define FREERTOS_STACK_ROUND			16
+#endif
+
+/**
+ * Set FREERTOS_CONTEXT_SWITCH_COUNT to 1 to count how many times each task is
+ * switched in. Requires traceTASK_SWITCHED_IN() to call
+ * freertos_task_switched_in() from idle_task.c, the counter is kept in the
+ * thread local storage pointer FREERTOS_CONTEXT_SWITCH_TLS_INDEX.
+ */
+#ifndef FREERTOS_CONTEXT_SWITCH_COUNT
+#define FREERTOS_CONTEXT_SWITCH_COUNT		0
+#endif
+
+#ifndef FREERTOS_CONTEXT_SWITCH_TLS_INDEX
+#define FREERTOS_CONTEXT_SWITCH_TLS_INDEX	(configNUM_THREAD_LOCAL_STORAGE_POINTERS - 1)
+#endif
+
+/**
+ * Coroutine frames are taken from a static pool of FREERTOS_COROUTINE_FRAMES
+ * blocks of FREERTOS_COROUTINE_FRAME_SIZE bytes each.
+ */
+#ifndef FREERTOS_COROUTINE_FRAMES
+#define FREERTOS_COROUTINE_FRAMES		8
+#endif
+
+#ifndef FREERTOS_COROUTINE_FRAME_SIZE
+#define FREERTOS_COROUTINE_FRAME_SIZE		256
+#endif
+
+/**
+ * Maximum number of distinct semaphores and queues a CoroutineScheduler
+ * can wait on at the same time.
+ */
+#ifndef FREERTOS_COROUTINE_OBJECTS
+#define FREERTOS_COROUTINE_OBJECTS		8
+#endif
+
+/**
+ * Set FREERTOS_DEFERRED_INIT to 1 to enable constexpr constructors taking the
+ * Deferred tag. Such objects can be constant initialized (no code runs before
+ * main) and create their kernel objects later in Init() or InitAll().
+ */
+#ifndef FREERTOS_DEFERRED_INIT
+#define FREERTOS_DEFERRED_INIT			0
+#endif
+
+#if defined(__cpp_constinit)
+#define FREERTOS_CONSTINIT constinit
+#else
+#define FREERTOS_CONSTINIT
+#endif
+
+/**
+ * Number of Defer requests that can be pending at once and size in bytes of
+ * callable storage in each of them.
+ */
+#ifndef FREERTOS_DEFER_SLOTS
+#define FREERTOS_DEFER_SLOTS			8
+#endif
+#ifndef FREERTOS_DEFER_SIZE
+#define FREERTOS_DEFER_SIZE			(4 * sizeof(void *))
+#endif
+
+/**
+ * Time in [ms] a StateMachine waits for space in the timer command queue when
+ * it arms a state timeout. A timeout that could not be armed is counted as
+ * lost.
+ */
+#ifndef FREERTOS_STATE_TIMER_WAIT_MS
+#define FREERTOS_STATE_TIMER_WAIT_MS		10
+#endif
+
+/**
+ * Time source used by profiling code. Default resolution is one tick, define
+ * it to a cycle counter (e.g. DWT->CYCCNT) for finer measurements.
+ */
+#ifndef FREERTOS_PROFILING_CLOCK
+#define FREERTOS_PROFILING_CLOCK()		((uint32_t)xTaskGetTickCount())
+#endif
+
+/**
+ * Frequency of FREERTOS_PROFILING_CLOCK() in [Hz], define it together with
+ * the clock.
+ */
+#ifndef FREERTOS_PROFILING_CLOCK_HZ
+#define FREERTOS_PROFILING_CLOCK_HZ		configTICK_RATE_HZ
+#endif
+
 #ifdef __has_cpp_attribute
 #if __has_cpp_attribute(nodiscard)
 #define FREERTOS_NODISCARD [[nodiscard]]
@@ -75,743 +298,6941 @@ namespace FreeRTOS
 		vTaskEndScheduler();
 	}
 
+#if (FREERTOS_LOCK_PROFILING == 1)
 	/**
-	 * @brief Implement locking mechanism between tasks to protect shared
-	 * resources against race conditions.
+	 * @brief Contention statistics collected for a Mutex or semaphore.
+	 *
+	 * Times are in FREERTOS_PROFILING_CLOCK() units.
 	 */
-	class Mutex
+	struct LockStats
+	{
+		const char *name = nullptr;
+		uint32_t acquisitions = 0;
+		uint32_t contentions = 0;
+		uint32_t wait_total = 0;
+		uint32_t wait_max = 0;
+		uint32_t hold_total = 0;
+		uint32_t hold_max = 0;
+		char last_owner[configMAX_TASK_NAME_LEN] = {};
+	};
+#endif /* FREERTOS_LOCK_PROFILING */
+
+#if (FREERTOS_LOCK_DEBUG == 1)
+	/**
+	 * @brief Global lock order graph used to detect potential deadlocks.
+	 *
+	 * Every time a task takes mutex B while holding mutex A, the edge
+	 * A -> B is recorded. If taking B is possible to reach A through
+	 * recorded edges, the acquisition closes a cycle and is reported.
+	 */
+	class LockOrder
 	{
-	protected:
-#if (configSUPPORT_STATIC_ALLOCATION == 1)
-		StaticSemaphore_t buffer;
-#endif /* STATIC_ALLOCATION */
-		SemaphoreHandle_t handle = nullptr;
 	public:
 		/**
-		 * @brief Creates an instance of mutex.
+		 * @brief Description of lock order violation.
 		 */
-		Mutex() {
-#if (configSUPPORT_STATIC_ALLOCATION == 1)
-			handle = xSemaphoreCreateMutexStatic(&buffer);
-#else /* STATIC_ALLOCATION */
-			handle = xSemaphoreCreateMutex();
-			configASSERT(handle != nullptr);
-#endif /* STATIC_ALLOCATION */
-		}
+		struct Violation
+		{
+			/** Task trying to take the lock. */
+			const char *task;
+			/** Lock being taken. */
+			const char *lock;
+			/** Lock already held by the task. */
+			const char *held;
+			/** Task that recorded the opposite order before. */
+			const char *other_task;
+			/** First lock taken after 'lock' in opposite order. */
+			const char *via;
+		};
 
 		/**
-		 * @brief Deletes the instance and release allocated memory.
+		 * @brief Install violation handler. By default configASSERT
+		 * is triggered.
+		 *
+		 * @param[in] handler	Function to call on violation.
 		 */
-		~Mutex() {
-			if (handle)
-				vSemaphoreDelete(handle);
-			handle = nullptr;
+		static void SetHandler(void (*handler)(const Violation &)) {
+			report = handler;
 		}
 
 		/**
-		 * @brief Obtain a mutex.
+		 * @brief Add lock to the graph.
 		 *
-		 * @param[in] wait_ms	[Optional] Amount of milliseconds to
-		 *			wait for resource to be available.
+		 * @param[in] name	Lock name for reports.
 		 *
-		 * @return true if success, false on timeout.
+		 * @return Lock identifier, -1 if graph is full.
 		 */
-		bool Lock(size_t wait_ms = WAIT_MAX) {
-			return xSemaphoreTake(handle,
-			                      pdMS_TO_TICKS(wait_ms)) == pdTRUE;
+		static int Register(const char *name) {
+			int id = -1;
+
+			vTaskSuspendAll();
+			for (int i = 0; i != FREERTOS_LOCK_DEBUG_MAX_LOCKS; i++) {
+				if (!(used & Bit(i))) {
+					used |= Bit(i);
+					names[i] = name;
+					id = i;
+					break;
+				}
+			}
+			xTaskResumeAll();
+			return id;
 		}
 
 		/**
-		 * @brief Release an obtained mutex.
+		 * @brief Remove lock and all its edges from the graph.
 		 *
-		 * @return true if success,
-		 * false if no mutex was obtained before.
+		 * @param[in] id	Lock identifier.
 		 */
-		bool Unlock() {
-			return xSemaphoreGive(handle) == pdTRUE;
+		static void Unregister(int id) {
+			vTaskSuspendAll();
+			used &= ~Bit(id);
+			after[id] = 0;
+			holder[id] = nullptr;
+			for (int i = 0; i != FREERTOS_LOCK_DEBUG_MAX_LOCKS; i++)
+				after[i] &= ~Bit(id);
+			xTaskResumeAll();
 		}
 
 		/**
-		 * @brief Prevent class to be copied.
+		 * @brief Validate and record acquisition before blocking.
+		 *
+		 * @param[in] id	Lock identifier.
 		 */
-		Mutex(const Mutex &) = delete;
+		static void Acquire(int id) {
+			TaskHandle_t self = xTaskGetCurrentTaskHandle();
+			Violation v = {};
+			bool failed = false;
+
+			vTaskSuspendAll();
+			Mask reach = Reach(id);
+			for (int h = 0; h != FREERTOS_LOCK_DEBUG_MAX_LOCKS; h++) {
+				if (holder[h] != self)
+					continue;
+				if (h == id || (reach & Bit(h))) {
+					int k = h == id ? id : Next(id, h);
+					v.lock = Name(id);
+					v.held = Name(h);
+					v.via = Name(k);
+					v.other_task = h == id ? "-" :
+						TaskName(edge_task[id][k]);
+					failed = true;
+					break;
+				}
+				if (!(after[h] & Bit(id))) {
+					after[h] |= Bit(id);
+					edge_task[h][id] = Intern(self);
+				}
+			}
+			xTaskResumeAll();
+
+			if (failed) {
+				v.task = pcTaskGetName(self);
+				if (report)
+					report(v);
+				else
+					configASSERT(0);
+			}
+		}
 
 		/**
-		 * @brief Obtain a mutex from interrupt context.
+		 * @brief Mark lock as held by calling task.
 		 *
-		 * @return true if success, false if failed.
+		 * @param[in] id	Lock identifier.
 		 */
-		bool LockFromISR() {
-			return xSemaphoreTakeFromISR(handle, nullptr) == pdTRUE;
+		static void Acquired(int id) {
+			holder[id] = xTaskGetCurrentTaskHandle();
 		}
 
 		/**
-		 * @brief Release an obtained mutex from interrupt context.
+		 * @brief Mark lock as released.
 		 *
-		 * @return true if success,
-		 * false if no mutex was obtained before.
+		 * @param[in] id	Lock identifier.
 		 */
-		bool UnlockFromISR() {
-			return xSemaphoreGiveFromISR(handle, nullptr) == pdTRUE;
+		static void Released(int id) {
+			holder[id] = nullptr;
+		}
+	protected:
+		static_assert(FREERTOS_LOCK_DEBUG_MAX_LOCKS <= 64,
+			"FREERTOS_LOCK_DEBUG_MAX_LOCKS is limited to 64");
+		static_assert(FREERTOS_LOCK_DEBUG_MAX_TASKS < 0xFF,
+			"FREERTOS_LOCK_DEBUG_MAX_TASKS is limited to 254");
+		using Mask = typename std::conditional<
+			(FREERTOS_LOCK_DEBUG_MAX_LOCKS > 32),
+			uint64_t, uint32_t>::type;
+
+		static inline void (*report)(const Violation &) = nullptr;
+		static inline Mask used = 0;
+		static inline Mask after[FREERTOS_LOCK_DEBUG_MAX_LOCKS];
+		static inline const char *names[FREERTOS_LOCK_DEBUG_MAX_LOCKS];
+		static inline TaskHandle_t holder[FREERTOS_LOCK_DEBUG_MAX_LOCKS];
+		static inline uint8_t edge_task[FREERTOS_LOCK_DEBUG_MAX_LOCKS]
+		                               [FREERTOS_LOCK_DEBUG_MAX_LOCKS];
+		static inline char task_names[FREERTOS_LOCK_DEBUG_MAX_TASKS]
+		                             [configMAX_TASK_NAME_LEN];
+		static inline size_t task_count = 0;
+
+		static constexpr Mask Bit(int i) {
+			return (Mask)1 << i;
+		}
+
+		static const char *Name(int id) {
+			return names[id] ? names[id] : "-";
+		}
+
+		/* All locks ever taken after 'id', directly or indirectly */
+		static Mask Reach(int id) {
+			Mask reach = after[id];
+			Mask prev;
+			do {
+				prev = reach;
+				for (int i = 0; i != FREERTOS_LOCK_DEBUG_MAX_LOCKS;
+				     i++)
+					if (prev & Bit(i))
+						reach |= after[i];
+			} while (reach != prev);
+			return reach;
+		}
+
+		/* First step on the recorded path from 'from' to 'to' */
+		static int Next(int from, int to) {
+			for (int k = 0; k != FREERTOS_LOCK_DEBUG_MAX_LOCKS; k++)
+				if ((after[from] & Bit(k)) &&
+				    (k == to || (Reach(k) & Bit(to))))
+					return k;
+			return to;
+		}
+
+		static uint8_t Intern(TaskHandle_t task) {
+			const char *name = pcTaskGetName(task);
+			for (size_t i = 0; i != task_count; i++)
+				if (!strncmp(task_names[i], name,
+				             configMAX_TASK_NAME_LEN - 1))
+					return i;
+			if (task_count == FREERTOS_LOCK_DEBUG_MAX_TASKS)
+				return 0xFF;
+			strncpy(task_names[task_count], name,
+			        configMAX_TASK_NAME_LEN - 1);
+			return task_count++;
+		}
+
+		static const char *TaskName(uint8_t idx) {
+			return idx < task_count ? task_names[idx] : "?";
 		}
 	};
+#endif /* FREERTOS_LOCK_DEBUG */
 
+#if (FREERTOS_BLOCKING_TRACE == 1)
 	/**
-	 * @brief Create binary semaphore.
+	 * @brief Kind of object a task is blocked on.
 	 */
-	class BinarySemaphore : public Mutex
+	enum class BlockKind : uint8_t { Mutex, Semaphore, Queue };
+
+	/**
+	 * @brief Records who blocked whom and computes blocking chains.
+	 *
+	 * When a task blocks on a Mutex, semaphore or Queue, the chain of
+	 * tasks it transitively waits for is captured: the mutex holder, or
+	 * the last task that gave the semaphore or pushed into the queue,
+	 * what that task is blocked on, and so on. The longest blocking of
+	 * each task is kept together with its chain.
+	 *
+	 * Records are found through FREERTOS_BLOCKING_TRACE_TLS_INDEX of the
+	 * task and dropped by Task::Delete(), so a task created in a reused
+	 * TCB starts with a fresh record.
+	 */
+	class BlockingTrace
 	{
-	private:
-		using Mutex::Mutex;
-		using Mutex::Lock;
-		using Mutex::LockFromISR;
-		using Mutex::Unlock;
-		using Mutex::UnlockFromISR;
+		static_assert(FREERTOS_BLOCKING_TRACE_TLS_INDEX >= 0 &&
+			FREERTOS_BLOCKING_TRACE_TLS_INDEX <
+			configNUM_THREAD_LOCAL_STORAGE_POINTERS,
+			"No thread local storage pointer for blocking trace");
+#if (FREERTOS_CONTEXT_SWITCH_COUNT == 1)
+		static_assert(FREERTOS_BLOCKING_TRACE_TLS_INDEX !=
+			FREERTOS_CONTEXT_SWITCH_TLS_INDEX,
+			"Blocking trace shares switch counter storage pointer");
+#endif /* FREERTOS_CONTEXT_SWITCH_COUNT */
 	public:
 		/**
-		 * @brief Create a binary semaphore.
+		 * @brief One step of a blocking chain.
 		 */
-		BinarySemaphore() {
-#if (configSUPPORT_STATIC_ALLOCATION == 1)
-			handle = xSemaphoreCreateBinaryStatic(&buffer);
-#else /* STATIC_ALLOCATION */
-			handle = xSemaphoreCreateBinary();
-			configASSERT(handle != nullptr);
-#endif /* STATIC_ALLOCATION */
-		}
+		struct Link
+		{
+			/** Task name. */
+			char task[configMAX_TASK_NAME_LEN];
+			/** Object the task waits for, nullptr if not blocked. */
+			const char *object;
+			BlockKind kind;
+		};
 
 		/**
-		 * @brief Give semaphore.
+		 * @brief Blocking chain starting with the blocked task.
+		 */
+		struct Chain
+		{
+			/** Blocking time in FREERTOS_PROFILING_CLOCK() units. */
+			uint32_t duration;
+			size_t length;
+			Link links[FREERTOS_BLOCKING_TRACE_DEPTH];
+		};
+
+		/**
+		 * @brief Completed blocking.
+		 */
+		struct Event
+		{
+			/** Time the task blocked. */
+			uint32_t time;
+			uint32_t duration;
+			char task[configMAX_TASK_NAME_LEN];
+			const char *object;
+			/** Task expected to release the object. */
+			char owner[configMAX_TASK_NAME_LEN];
+			BlockKind kind;
+		};
+
+		/**
+		 * @brief Record calling task blocking on an object.
 		 *
-		 * @return true if given, false if already given before.
+		 * @param[in] object	Object identity.
+		 * @param[in] name	Object name.
+		 * @param[in] kind	Object kind.
+		 * @param[in] owner	Record id of task expected to release
+		 *			the object, see Touch().
 		 */
-		inline bool Give() {
-			return Mutex::Unlock();
+		static void Begin(const void *object, const char *name,
+		                  BlockKind kind, uint32_t owner) {
+			uint32_t now = FREERTOS_PROFILING_CLOCK();
+
+			vTaskSuspendAll();
+			Record *r = Current(true);
+			if (r) {
+				r->object = object;
+				r->object_name = name ? name : "-";
+				r->kind = kind;
+				r->owner = owner;
+				r->since = now;
+				Chain &c = r->current;
+				c.length = 0;
+				for (Record *i = r; i &&
+				     c.length != FREERTOS_BLOCKING_TRACE_DEPTH;
+				     i = Find(i->owner)) {
+					Link &l = c.links[c.length++];
+					memcpy(l.task, i->name, sizeof(l.task));
+					l.object = i->object ?
+						i->object_name : nullptr;
+					l.kind = i->kind;
+					if (!i->object || !i->owner)
+						break;
+				}
+			}
+			xTaskResumeAll();
 		}
 
 		/**
-		 * @brief Wait for semaphore to be given.
-		 *
-		 * @param[in] wait_ms	[Optional] Time to wait in [ms].
-		 *
-		 * @return true if semaphore obtained successfully, false
-		 * on timeout.
+		 * @brief Record calling task is no longer blocked.
 		 */
-		inline bool Take(size_t wait_ms = WAIT_MAX) {
-			return Mutex::Lock(wait_ms);
+		static void End() {
+			uint32_t now = FREERTOS_PROFILING_CLOCK();
+
+			vTaskSuspendAll();
+			Record *r = Current(false);
+			if (r && r->object) {
+				Chain &c = r->current;
+				c.duration = now - r->since;
+				if (!r->worst.length ||
+				    c.duration >= r->worst.duration)
+					r->worst = c;
+
+				Event &e = events[event_next++ %
+				                  FREERTOS_BLOCKING_TRACE_EVENTS];
+				e.time = r->since;
+				e.duration = c.duration;
+				memcpy(e.task, r->name, sizeof(e.task));
+				e.object = r->object_name;
+				strncpy(e.owner, c.length > 1 ? c.links[1].task : "-",
+				        sizeof(e.owner));
+				e.kind = r->kind;
+				r->object = nullptr;
+			}
+			xTaskResumeAll();
 		}
 
 		/**
-		 * @brief Give semaphore from ISR.
+		 * @brief Create a record of calling task becoming an owner.
 		 *
-		 * @return true if given, false if already given before.
+		 * @return Record id passed to Begin(), 0 if out of records.
 		 */
-		inline bool GiveFromISR() {
-			return Mutex::UnlockFromISR();
+		static uint32_t Touch() {
+			vTaskSuspendAll();
+			Record *r = Current(true);
+			uint32_t id = r ? r->id : 0;
+			xTaskResumeAll();
+			return id;
 		}
 
 		/**
-		 * @brief Wait for semaphore to be given from ISR.
+		 * @brief Drop the record of a task about to be deleted.
 		 *
-		 * @return true if semaphore obtained successfully, false
-		 * on timeout.
+		 * @param[in] task	Task handle, nullptr for calling task.
 		 */
-		inline bool TakeFromISR() {
-			return Mutex::LockFromISR();
+		static void Forget(TaskHandle_t task) {
+			vTaskSuspendAll();
+			Record *r = Find(Id(task));
+			if (r)
+				memset(r, 0, sizeof(*r));
+			vTaskSetThreadLocalStoragePointer(task,
+				FREERTOS_BLOCKING_TRACE_TLS_INDEX, nullptr);
+			xTaskResumeAll();
 		}
-	};
 
-	/**
-	 * @brief Create counting semaphore.
-	 */
-	class CountingSemaphore : public BinarySemaphore
-	{
-	public:
 		/**
-		 * @brief Create counting semaphore with initial count and max
-		 * value.
+		 * @brief Get the longest blocking of a task.
 		 *
-		 * @param[in] initial		Initial count value.
-		 * @param[in] max		The maximum count value that can
-		 *				be reached. When the semaphore
-		 *				reaches this value it can no
-		 *				longer be 'given'.
+		 * @param[in] task	Task handle.
+		 * @param[out] out	Blocking chain.
+		 *
+		 * @return true if task has ever blocked.
 		 */
-		CountingSemaphore(size_t initial = 0, size_t max = 100) {
-#if (configSUPPORT_STATIC_ALLOCATION == 1)
-			handle = xSemaphoreCreateCountingStatic(max, initial,
-			                                        &buffer);
-#else /* STATIC_ALLOCATION */
-			handle = xSemaphoreCreateCounting(max, initial);
-			configASSERT(handle != nullptr);
-#endif /* STATIC_ALLOCATION */
+		static bool WorstChain(TaskHandle_t task, Chain &out) {
+			vTaskSuspendAll();
+			Record *r = Find(Id(task));
+			bool ret = r && r->worst.length;
+			if (ret)
+				out = r->worst;
+			xTaskResumeAll();
+			return ret;
 		}
 
 		/**
-		 * @brief Read current count value.
+		 * @brief Copy recent blocking events, oldest first.
 		 *
-		 * @return Count value.
+		 * @param[out] out	Destination array.
+		 * @param[in] max	Size of destination array.
+		 *
+		 * @return Number of events copied.
 		 */
-		FREERTOS_NODISCARD
-		size_t GetCount() {
-			return uxSemaphoreGetCount(handle);
+		static size_t Events(Event *out, size_t max) {
+			size_t n = 0;
+
+			vTaskSuspendAll();
+			size_t count = event_next < FREERTOS_BLOCKING_TRACE_EVENTS ?
+				event_next : FREERTOS_BLOCKING_TRACE_EVENTS;
+			if (count > max)
+				count = max;
+			for (size_t i = event_next - count; i != event_next; i++)
+				out[n++] = events[i % FREERTOS_BLOCKING_TRACE_EVENTS];
+			xTaskResumeAll();
+			return n;
 		}
-	};
 
-	/**
-	 * @brief Responsible for creating, control and delete FreeRTOS tasks.
-	 *
-	 * @tparam stack_size		[Optional] The number of words
-	 *				(not bytes) for use as the task's stack.
-	 */
-	template <const size_t stack_size = FREERTOS_DEFAULT_TASK_STACK_SIZE>
-	class Task
-	{
-	protected:
-		TaskHandle_t handle = nullptr;
-#if (configSUPPORT_STATIC_ALLOCATION == 1)
-		StackType_t xStack[stack_size];
-		StaticTask_t xTaskBuffer;
-#endif /* STATIC_ALLOCATION */
-	public:
 		/**
-		 * @brief Create a new task and
-		 * add it to the list of tasks that are ready to run.
+		 * @brief Print the worst blocking chain of every task.
 		 *
-		 * @param[in] handler	Pointer to the task entry function.
-		 * @param[in] params	[Optional] A value that is passed as the
-		 *			parameter to the created task.
-		 * @param[in] name	[Optional] Task name string.
-		 * @param[in] priority	[Optional] The priority at which the
-		 *			task will execute.
+		 * @param[in] print	Function to output a single line.
 		 */
-		Task(void (*handler)(void *),
-			void *params = nullptr,
-			const char *name = nullptr,
-			int priority = tskIDLE_PRIORITY + 1) {
-#if (configSUPPORT_STATIC_ALLOCATION == 1)
-			handle = xTaskCreateStatic(handler,
-			                           name,
-			                           stack_size,
-			                           params,
-			                           tskIDLE_PRIORITY + priority,
-			                           xStack,
-			                           &xTaskBuffer);
-			configASSERT(handle != nullptr);
-#else /* STATIC_ALLOCATION */
-			configASSERT(xTaskCreate(handler,
-			                         name,
-			                         stack_size,
-			                         params,
-			                         tskIDLE_PRIORITY + priority,
-			                         &handle) == pdPASS);
-#endif /* STATIC_ALLOCATION */
-		}
+		static void Dump(void (*print)(const char *line)) {
+			static const char *const kinds[] = {
+				"mutex", "semaphore", "queue" };
+			char line[160];
 
-		~Task() { Delete(); }
+			for (size_t t = 0; t != FREERTOS_BLOCKING_TRACE_MAX_TASKS;
+			     t++) {
+				Chain c;
+				vTaskSuspendAll();
+				bool found = records[t].id && records[t].worst.length;
+				if (found)
+					c = records[t].worst;
+				xTaskResumeAll();
+				if (!found)
+					continue;
+				int len = snprintf(line, sizeof(line), "%lu:",
+					(unsigned long)c.duration);
+				for (size_t i = 0; i != c.length && len > 0 &&
+				     (size_t)len < sizeof(line); i++) {
+					const Link &l = c.links[i];
+					len += snprintf(line + len,
+						sizeof(line) - len,
+						" %s", l.task);
+					if (l.object && (size_t)len < sizeof(line))
+						len += snprintf(line + len,
+							sizeof(line) - len,
+							" -> %s %s ->",
+							kinds[(int)l.kind],
+							l.object);
+				}
+				print(line);
+			}
+		}
 
-#if (INCLUDE_vTaskDelete == 1)
 		/**
-		 * @brief Delete current task.
+		 * @brief Forget all recorded tasks and events.
 		 */
-		void Delete() {
-			if (handle)
-				vTaskDelete(handle);
-			handle = nullptr;
+		static void Reset() {
+			vTaskSuspendAll();
+			memset(records, 0, sizeof(records));
+			event_next = 0;
+			xTaskResumeAll();
 		}
+	protected:
+		struct Record
+		{
+			/** Never reused, 0 if the record is free. */
+			uint32_t id;
+			char name[configMAX_TASK_NAME_LEN];
+			const void *object;
+			const char *object_name;
+			BlockKind kind;
+			uint32_t owner;
+			uint32_t since;
+			Chain current;
+			Chain worst;
+		};
 
-		static void SelfDelete() {
-			vTaskDelete(nullptr);
+		static inline Record records[FREERTOS_BLOCKING_TRACE_MAX_TASKS];
+		static inline Event events[FREERTOS_BLOCKING_TRACE_EVENTS];
+		static inline size_t event_next = 0;
+		static inline uint32_t last_id = 0;
+
+		static uint32_t Id(TaskHandle_t task) {
+			return (uint32_t)(uintptr_t)pvTaskGetThreadLocalStoragePointer(
+				task, FREERTOS_BLOCKING_TRACE_TLS_INDEX);
 		}
-#endif /* INCLUDE_vTaskDelete */
 
-#if (INCLUDE_vTaskSuspend == 1)
-		/**
-		 * @brief Put current task into idle state.
-		 */
-		void Suspend() {
-			vTaskSuspend(handle);
+		static Record *Find(uint32_t id) {
+			if (!id)
+				return nullptr;
+			for (Record &r : records)
+				if (r.id == id)
+					return &r;
+			return nullptr;
 		}
-#endif /* INCLUDE_vTaskSuspend */
 
-#if (INCLUDE_vTaskSuspend == 1)
-		/**
-		 * @brief Wake up current task.
-		 */
-		void Resume() {
-			vTaskResume(handle);
+		/* Called with the scheduler suspended */
+		static Record *Current(bool create) {
+			Record *r = Find(Id(nullptr));
+
+			if (r || !create)
+				return r;
+			for (Record &i : records)
+				if (!i.id) {
+					r = &i;
+					break;
+				}
+			if (!r)
+				return nullptr;
+			memset(r, 0, sizeof(*r));
+			if (!++last_id)
+				last_id++;
+			r->id = last_id;
+			strncpy(r->name, pcTaskGetName(nullptr),
+			        sizeof(r->name) - 1);
+			vTaskSetThreadLocalStoragePointer(nullptr,
+				FREERTOS_BLOCKING_TRACE_TLS_INDEX,
+				(void *)(uintptr_t)r->id);
+			return r;
 		}
-#endif /* INCLUDE_vTaskSuspend */
+	};
+#endif /* FREERTOS_BLOCKING_TRACE */
 
-#if (INCLUDE_eTaskGetState == 1)
-		/**
-		 * @brief Get current task state.
-		 */
-		enum TaskState { Ready, Running, Blocked, Suspended, Deleted };
-		FREERTOS_NODISCARD
-		TaskState GetState() {
-			eTaskState state = eTaskGetState(handle);
-			return (TaskState)state;
+#if (FREERTOS_DEFERRED_INIT == 1)
+	/**
+	 * @brief Tag selecting constexpr constructors that only store the
+	 * parameters. The kernel object is created by Init().
+	 */
+	struct DeferredInit
+	{
+		explicit constexpr DeferredInit() = default;
+	};
+
+	inline constexpr DeferredInit Deferred {};
+
+	/**
+	 * @brief Create kernel objects of all given deferred objects, call
+	 * before StartScheduler().
+	 *
+	 * @param[in] objects	Objects constructed with Deferred.
+	 */
+	template <class... Objects>
+	void InitAll(Objects &...objects) {
+		(objects.Init(), ...);
+	}
+#endif /* FREERTOS_DEFERRED_INIT */
+
+	/**
+	 * @brief Wake-up registered by a stop-aware call for the time it
+	 * blocks. Lives on the stack of the blocked task.
+	 */
+	struct StopCallback
+	{
+		void (*fn)(void *arg);
+		void *arg;
+		StopCallback *next;
+	};
+
+	class StopToken;
+
+	/**
+	 * @brief Requests a cooperative stop.
+	 *
+	 * Code observing the token returns from stop-aware blocking calls and
+	 * is expected to release its resources and finish. Every such call
+	 * registers how to wake it through the object it blocks on, so other
+	 * blocking calls of the task are not disturbed.
+	 */
+	class StopSource
+	{
+	protected:
+		std::atomic<bool> stop {false};
+		mutable StopCallback *callbacks = nullptr;
+
+		friend class StopToken;
+
+		bool Register(StopCallback &cb) const {
+			vTaskSuspendAll();
+			bool stopped = StopRequested();
+			if (!stopped) {
+				cb.next = callbacks;
+				callbacks = &cb;
+			}
+			xTaskResumeAll();
+			return !stopped;
 		}
-#endif /* INCLUDE_eTaskGetState */
 
-		/**
-		 * @brief Suspends the scheduler.
-		 *
-		 * Suspending the scheduler prevents a context switch from
-		 * occurring but leaves interrupts enabled. If an interrupt
-		 * requests a context switch while the scheduler is suspended,
-		 * then the request is held pending and is performed only when
-		 * the scheduler is resumed (un-suspended).
-		 */
-		static inline void SuspendAll() {
+		void Unregister(StopCallback &cb) const {
 			vTaskSuspendAll();
+			for (StopCallback **p = &callbacks; *p; p = &(*p)->next) {
+				if (*p == &cb) {
+					*p = cb.next;
+					break;
+				}
+			}
+			xTaskResumeAll();
 		}
+	public:
+		constexpr StopSource() {}
 
 		/**
-		 * @brief Resumes the scheduler after it was suspended using
-		 * a call to vTaskSuspendAll().
+		 * @brief Request stop and wake stop-aware calls blocked on
+		 * this source.
 		 */
-		static inline void ResumeAll() {
+		void RequestStop() {
+			stop.store(true, std::memory_order_release);
+
+			vTaskSuspendAll();
+			for (StopCallback *cb = callbacks; cb; cb = cb->next)
+				cb->fn(cb->arg);
+			callbacks = nullptr;
 			xTaskResumeAll();
 		}
 
 		/**
-		 * @brief taskYIELD() is used to request a context switch to
-		 * another task. However, if there are no other tasks at a
-		 * higher or equal priority to the task that calls taskYIELD()
-		 * then the RTOS scheduler will simply select the task that
-		 * called taskYIELD() to run again.
+		 * @brief Clear the stop request, e.g. before restarting.
 		 */
-		static inline void DoYield() {
-			taskYIELD();
+		void Reset() {
+			stop.store(false, std::memory_order_release);
 		}
 
 		/**
-		 * @brief Critical sections are entered by calling
-		 * taskENTER_CRITICAL(), and subsequently exited by calling
-		 * taskEXIT_CRITICAL().
+		 * @brief Check if stop was requested.
 		 */
-		static inline void EnterCritical() {
-			taskENTER_CRITICAL();
+		FREERTOS_NODISCARD
+		bool StopRequested() const {
+			return stop.load(std::memory_order_acquire);
 		}
 
 		/**
-		 * @brief Critical sections are entered by calling
-		 * taskENTER_CRITICAL(), and subsequently exited by calling
-		 * taskEXIT_CRITICAL().
-		 *
-		 * The taskENTER_CRITICAL() and taskEXIT_CRITICAL() macros
-		 * provide a basic critical section implementation that works
-		 * by simply disabling interrupts, either globally, or up to a
-		 * specific interrupt priority level. See the vTaskSuspendAll()
-		 * RTOS API function for information on creating a critical
-		 * section without disabling interrupts.
+		 * @brief Get token observing this source.
 		 */
-		static inline void ExitCritical() {
-			taskEXIT_CRITICAL();
-		}
+		FREERTOS_NODISCARD
+		StopToken GetToken() const;
 
 		/**
 		 * @brief Prevent class to be copied.
 		 */
-		Task(const Task &) = delete;
+		StopSource(const StopSource &) = delete;
+	};
+
+	/**
+	 * @brief Observes a stop request made through StopSource.
+	 *
+	 * A default constructed token is never stopped.
+	 */
+	class StopToken
+	{
+	protected:
+		const StopSource *source = nullptr;
+	public:
+		StopToken() = default;
+
+		explicit StopToken(const StopSource *source)
+			: source(source) {}
 
-#if (configUSE_TASK_NOTIFICATIONS == 1)
 		/**
-		 * @brief Send notify to task.
-		 *
-		 * @param[in] index		[Optional] he index within the
-		 *				target task's array of
-		 *				notification values to which the
-		 *				notification is to be sent.
+		 * @brief Check if stop was requested.
 		 */
-		void NotifyGive(int index = -1) {
-			if (index >= 0) {
-				configASSERT(xTaskNotifyGiveIndexed(handle,
-					index) == pdPASS);
-			} else {
-				configASSERT(xTaskNotifyGive(handle) == pdPASS);
-			}
+		FREERTOS_NODISCARD
+		bool StopRequested() const {
+			return source && source->StopRequested();
 		}
 
 		/**
-		 * @brief Send notify to task from ISR.
-		 *
-		 * @param[in] index		[Optional] he index within the
-		 *				target task's array of
-		 *				notification values to which the
-		 *				notification is to be sent.
+		 * @brief Check if the token is associated with a source.
 		 */
-		void NotifyGiveFromISR(int index = -1) {
-			if (index >= 0) {
-				vTaskNotifyGiveIndexedFromISR(handle, index,
-				                              nullptr);
-			} else {
-				vTaskNotifyGiveFromISR(handle, nullptr);
-			}
+		FREERTOS_NODISCARD
+		bool StopPossible() const {
+			return source != nullptr;
 		}
 
 		/**
-		 * @brief Wait for notify.
+		 * @brief Repeat a blocking attempt until it succeeds, the time
+		 * runs out or stop is requested.
 		 *
-		 * @param wait_ms		Time to wait in [ms].
-		 * @param reset			[Optional] Reset notify after.
-		 * @param index			[Optional] Index to wait for.
+		 * While the attempt blocks, RequestStop() runs wake from the
+		 * requesting task with the scheduler suspended. It must make
+		 * the attempt return without blocking, e.g. by giving the
+		 * semaphore the attempt takes.
 		 *
-		 * @return The value of the task's notification value before it
-		 * is decremented or cleared.
+		 * @param[in] wait_ms	Total time to wait in [ms].
+		 * @param[in] wake	Callable ending a blocked attempt.
+		 * @param[in] attempt	Callable taking time to block in [ms],
+		 *			returning true on success.
+		 *
+		 * @return true if attempt succeeded, false on timeout or stop.
 		 */
-		uint32_t NotifyTake(size_t wait_ms,
-		                    bool reset = true,
-		                    int index = -1) {
-			if (index >= 0) {
-				return ulTaskNotifyTakeIndexed(index, reset,
-					pdMS_TO_TICKS(wait_ms));
-			} else {
-				return ulTaskNotifyTake(reset,
-					pdMS_TO_TICKS(wait_ms));
+		template <class W, class F>
+		bool Wait(size_t wait_ms, W &&wake, F &&attempt) const {
+			using Wake = typename std::remove_reference<W>::type;
+
+			if (!source)
+				return attempt(wait_ms);
+
+			StopCallback cb = {
+				[](void *arg) { (*static_cast<Wake *>(arg))(); },
+				const_cast<void *>(static_cast<const void *>(&wake)),
+				nullptr
+			};
+			TimeOut_t timeout;
+			TickType_t left = wait_ms == WAIT_MAX ?
+				portMAX_DELAY : pdMS_TO_TICKS(wait_ms);
+			bool done = false;
+
+			if (!source->Register(cb))
+				return false;
+			vTaskSetTimeOutState(&timeout);
+			while (!StopRequested()) {
+				size_t ms = left == portMAX_DELAY ? WAIT_MAX :
+					((size_t)left * 1000 +
+					 configTICK_RATE_HZ - 1) /
+					configTICK_RATE_HZ;
+				if (attempt(ms)) {
+					done = true;
+					break;
+				}
+				if (xTaskCheckForTimeOut(&timeout, &left) == pdTRUE)
+					break;
 			}
+			source->Unregister(cb);
+			return done;
 		}
-#endif /* configUSE_TASK_NOTIFICATIONS */
+	};
 
-		/**
-		 * Critical section control can be used from interrupt context.
-		 */
-		class Isr
-		{
-		protected:
-			static inline UBaseType_t uxSavedInterruptStatus;
-		public:
-			/**
-			 * @brief See Task::EnterCritical()
-			 */
-			static void EnterCritical() {
-				uxSavedInterruptStatus =
-						taskENTER_CRITICAL_FROM_ISR();
+	inline StopToken StopSource::GetToken() const {
+		return StopToken(this);
+	}
+
+	/**
+	 * @brief Implement locking mechanism between tasks to protect shared
+	 * resources against race conditions.
+	 */
+	class Mutex
+	{
+	protected:
+#if (configSUPPORT_STATIC_ALLOCATION == 1)
+		StaticSemaphore_t buffer;
+#endif /* STATIC_ALLOCATION */
+		SemaphoreHandle_t handle = nullptr;
+		friend class CoroutineScheduler;
+#if (FREERTOS_DEFERRED_INIT == 1)
+		const char *init_name = nullptr;
+#endif /* FREERTOS_DEFERRED_INIT */
+#if (FREERTOS_LOCK_PROFILING == 1)
+		friend class LockRegistry;
+		static inline Mutex *lock_list = nullptr;
+		Mutex *next_lock = nullptr;
+		LockStats stats;
+		TaskHandle_t owner = nullptr;
+		uint32_t acquired_at = 0;
+		bool held = false;
+
+		void Register(const char *name) {
+			stats.name = name;
+			vTaskSuspendAll();
+			next_lock = lock_list;
+			lock_list = this;
+			xTaskResumeAll();
+		}
+
+		void Unregister() {
+			vTaskSuspendAll();
+			for (Mutex **p = &lock_list; *p; p = &(*p)->next_lock) {
+				if (*p == this) {
+					*p = next_lock;
+					break;
+				}
 			}
+			xTaskResumeAll();
+		}
 
-			/**
-			 * @brief See Task::ExitCritical()
-			 */
-			static void ExitCritical() {
-				taskEXIT_CRITICAL_FROM_ISR(uxSavedInterruptStatus);
+		void ProfiledLock(uint32_t start, bool contended, bool ret) {
+			uint32_t now = FREERTOS_PROFILING_CLOCK();
+			TaskHandle_t self = xTaskGetCurrentTaskHandle();
+
+			taskENTER_CRITICAL();
+			if (contended || !ret) {
+				uint32_t wait = now - start;
+				stats.contentions++;
+				stats.wait_total += wait;
+				if (wait > stats.wait_max)
+					stats.wait_max = wait;
 			}
-		};
+			if (ret) {
+				stats.acquisitions++;
+				acquired_at = now;
+				held = true;
+				if (owner != self) {
+					owner = self;
+					strncpy(stats.last_owner, pcTaskGetName(self),
+					        sizeof(stats.last_owner) - 1);
+				}
+			}
+			taskEXIT_CRITICAL();
+		}
+
+		void ProfiledUnlock() {
+			uint32_t now = FREERTOS_PROFILING_CLOCK();
+
+			taskENTER_CRITICAL();
+			if (held) {
+				uint32_t hold = now - acquired_at;
+				stats.hold_total += hold;
+				if (hold > stats.hold_max)
+					stats.hold_max = hold;
+				held = false;
+			}
+			taskEXIT_CRITICAL();
+		}
+#endif /* FREERTOS_LOCK_PROFILING */
+#if (FREERTOS_LOCK_DEBUG == 1)
+		int order_id = -1;
+#endif /* FREERTOS_LOCK_DEBUG */
+#if (FREERTOS_BLOCKING_TRACE == 1)
+		template <class, size_t> friend class Queue;
+		const char *trace_name = nullptr;
+		BlockKind trace_kind = BlockKind::Semaphore;
+		/* Record id of the holder or the last giver */
+		uint32_t trace_owner = 0;
+
+		void TraceRelease() {
+			if (trace_kind == BlockKind::Mutex)
+				trace_owner = 0;
+			else
+				trace_owner = BlockingTrace::Touch();
+		}
+#endif /* FREERTOS_BLOCKING_TRACE */
+#if (FREERTOS_LOCK_PROFILING == 1) || (FREERTOS_BLOCKING_TRACE == 1)
+		/* Try without waiting first to detect contention */
+		bool InstrumentedTake(size_t wait_ms) {
+			uint32_t start = FREERTOS_PROFILING_CLOCK();
+			bool ret = xSemaphoreTake(handle, 0) == pdTRUE;
+			bool contended = !ret && wait_ms;
+
+			if (contended) {
+#if (FREERTOS_BLOCKING_TRACE == 1)
+				BlockingTrace::Begin(this, trace_name,
+				                     trace_kind, trace_owner);
+#endif /* FREERTOS_BLOCKING_TRACE */
+				ret = xSemaphoreTake(handle,
+				                     pdMS_TO_TICKS(wait_ms)) == pdTRUE;
+#if (FREERTOS_BLOCKING_TRACE == 1)
+				BlockingTrace::End();
+#endif /* FREERTOS_BLOCKING_TRACE */
+			}
+#if (FREERTOS_BLOCKING_TRACE == 1)
+			if (ret && trace_kind == BlockKind::Mutex)
+				trace_owner = BlockingTrace::Touch();
+#endif /* FREERTOS_BLOCKING_TRACE */
+#if (FREERTOS_LOCK_PROFILING == 1)
+			ProfiledLock(start, contended, ret);
+#else /* FREERTOS_LOCK_PROFILING */
+			(void)start;
+#endif /* FREERTOS_LOCK_PROFILING */
+			return ret;
+		}
+#endif /* FREERTOS_LOCK_PROFILING || FREERTOS_BLOCKING_TRACE */
 
-#if (INCLUDE_vTaskDelete == 1)
 		/**
-		 * Class to execute code asynchronously.
+		 * @brief Tag used by derived classes to skip mutex creation.
 		 */
-		class DoAsync
-		{
-		protected:
-			void (*async_job)();
-			BinarySemaphore done;
+		struct Uncreated {};
+
+		/**
+		 * @brief Initialize common part without creating a kernel
+		 * object, the derived class creates its own.
+		 */
+		Mutex(const char *name, Uncreated) {
+			Setup(name);
+		}
+
+		void Setup(const char *name) {
+			(void)name;
+#if (FREERTOS_LOCK_PROFILING == 1)
+			Register(name);
+#endif /* FREERTOS_LOCK_PROFILING */
+#if (FREERTOS_BLOCKING_TRACE == 1)
+			trace_name = name;
+#endif /* FREERTOS_BLOCKING_TRACE */
+		}
+
+		void CreateMutex(const char *name) {
+			(void)name;
 #if (configSUPPORT_STATIC_ALLOCATION == 1)
-			StackType_t xStack[stack_size];
-			StaticTask_t xTaskBuffer;
+			handle = xSemaphoreCreateMutexStatic(&buffer);
+#else /* STATIC_ALLOCATION */
+			handle = xSemaphoreCreateMutex();
+			configASSERT(handle != nullptr);
 #endif /* STATIC_ALLOCATION */
-			static void handler(void *args) {
-				DoAsync *c = static_cast<DoAsync *>(args);
-				c->async_job();
-				c->done.Give();
-				Task::SelfDelete();
-			}
-		public:
-			/**
-			 * @brief Calls pointer to function from new task.
-			 * After job is done, task is self deleted.
-			 *
-			 * @param job		Callback function to call
-			 *			asynchronously.
-			 * @param priority	[Optional] Priority
-			 */
-			DoAsync(void (*job)(),
-			        size_t priority = 1) {
-				async_job = job;
+#if (FREERTOS_LOCK_DEBUG == 1)
+			order_id = LockOrder::Register(name);
+#endif /* FREERTOS_LOCK_DEBUG */
+#if (FREERTOS_BLOCKING_TRACE == 1)
+			trace_kind = BlockKind::Mutex;
+#endif /* FREERTOS_BLOCKING_TRACE */
+		}
+	public:
+		/**
+		 * @brief Creates an instance of mutex.
+		 */
+		Mutex() : Mutex(nullptr) {}
+
+		/**
+		 * @brief Creates a named instance of mutex.
+		 *
+		 * @param[in] name	Name used by profiling and tracing
+		 *			reports.
+		 */
+		explicit Mutex(const char *name)
+			: Mutex(name, Uncreated()) {
+			CreateMutex(name);
+		}
+
+#if (FREERTOS_DEFERRED_INIT == 1)
+		/**
+		 * @brief Constant initialize without creating the mutex.
+		 *
+		 * @param[in] name	[Optional] Name used by profiling and
+		 *			tracing reports.
+		 */
+		constexpr explicit Mutex(DeferredInit, const char *name = nullptr)
+			:
 #if (configSUPPORT_STATIC_ALLOCATION == 1)
-				configASSERT(xTaskCreateStatic(handler,
-			                           nullptr,
-			                           stack_size,
-			                           this,
-			                           tskIDLE_PRIORITY + priority,
-			                           xStack,
-			                           &xTaskBuffer) != nullptr);
-#else /* STATIC_ALLOCATION */
-				configASSERT(xTaskCreate(handler,
-			                         nullptr,
-			                         stack_size,
-			                         this,
-			                         tskIDLE_PRIORITY + priority,
-			                         nullptr) == pdPASS);
+			  buffer(),
 #endif /* STATIC_ALLOCATION */
-			}
-			~DoAsync() {
-				done.Take(WAIT_MAX);
-			}
-		};
-#endif /* INCLUDE_vTaskDelete */
+			  init_name(name) {}
+
+		/**
+		 * @brief Create the mutex of a deferred object.
+		 */
+		void Init() {
+			configASSERT(handle == nullptr);
+			Setup(init_name);
+			CreateMutex(init_name);
+		}
+#endif /* FREERTOS_DEFERRED_INIT */
+
+		/**
+		 * @brief Deletes the instance and release allocated memory.
+		 */
+		~Mutex() {
+#if (FREERTOS_LOCK_PROFILING == 1)
+			Unregister();
+#endif /* FREERTOS_LOCK_PROFILING */
+#if (FREERTOS_LOCK_DEBUG == 1)
+			if (order_id >= 0)
+				LockOrder::Unregister(order_id);
+#endif /* FREERTOS_LOCK_DEBUG */
+			if (handle)
+				vSemaphoreDelete(handle);
+			handle = nullptr;
+		}
+
+		/**
+		 * @brief Obtain a mutex.
+		 *
+		 * @param[in] wait_ms	[Optional] Amount of milliseconds to
+		 *			wait for resource to be available.
+		 *
+		 * @return true if success, false on timeout.
+		 */
+		bool Lock(size_t wait_ms = WAIT_MAX) {
+			bool ret;
+#if (FREERTOS_LOCK_DEBUG == 1)
+			if (order_id >= 0 && wait_ms)
+				LockOrder::Acquire(order_id);
+#endif /* FREERTOS_LOCK_DEBUG */
+#if (FREERTOS_LOCK_PROFILING == 1) || (FREERTOS_BLOCKING_TRACE == 1)
+			ret = InstrumentedTake(wait_ms);
+#else /* FREERTOS_LOCK_PROFILING || FREERTOS_BLOCKING_TRACE */
+			ret = xSemaphoreTake(handle,
+			                     pdMS_TO_TICKS(wait_ms)) == pdTRUE;
+#endif /* FREERTOS_LOCK_PROFILING || FREERTOS_BLOCKING_TRACE */
+#if (FREERTOS_LOCK_DEBUG == 1)
+			if (order_id >= 0 && ret)
+				LockOrder::Acquired(order_id);
+#endif /* FREERTOS_LOCK_DEBUG */
+			return ret;
+		}
+
+		/**
+		 * @brief Obtain a mutex unless stop is requested.
+		 *
+		 * Only the holder can give a mutex, so a stop request aborts
+		 * the wait with xTaskAbortDelay(). The mutex is taken in
+		 * slices of at most FREERTOS_STOP_POLL_MS with the token
+		 * checked in between, which bounds a stop missed just before
+		 * blocking.
+		 *
+		 * @param[in] wait_ms	Amount of milliseconds to wait for
+		 *			resource to be available.
+		 * @param[in] token	Stop token to observe.
+		 *
+		 * @return true if success, false on timeout or stop.
+		 */
+		bool Lock(size_t wait_ms, const StopToken &token) {
+			TaskHandle_t self = xTaskGetCurrentTaskHandle();
+
+			if (!token.StopPossible())
+				return Lock(wait_ms);
+			return token.Wait(wait_ms, [self] {
+#if (INCLUDE_xTaskAbortDelay == 1)
+				xTaskAbortDelay(self);
+#else /* INCLUDE_xTaskAbortDelay */
+				(void)self;
+#endif /* INCLUDE_xTaskAbortDelay */
+			}, [this](size_t slice) {
+				return Lock(slice < FREERTOS_STOP_POLL_MS ?
+				            slice : FREERTOS_STOP_POLL_MS);
+			});
+		}
+
+		/**
+		 * @brief Release an obtained mutex.
+		 *
+		 * @return true if success,
+		 * false if no mutex was obtained before.
+		 */
+		bool Unlock() {
+#if (FREERTOS_LOCK_PROFILING == 1)
+			ProfiledUnlock();
+#endif /* FREERTOS_LOCK_PROFILING */
+#if (FREERTOS_LOCK_DEBUG == 1)
+			if (order_id >= 0)
+				LockOrder::Released(order_id);
+#endif /* FREERTOS_LOCK_DEBUG */
+#if (FREERTOS_BLOCKING_TRACE == 1)
+			TraceRelease();
+#endif /* FREERTOS_BLOCKING_TRACE */
+			return xSemaphoreGive(handle) == pdTRUE;
+		}
+
+		/**
+		 * @brief Prevent class to be copied.
+		 */
+		Mutex(const Mutex &) = delete;
+
+		/**
+		 * @brief Obtain a mutex from interrupt context.
+		 *
+		 * @return true if success, false if failed.
+		 */
+		bool LockFromISR() {
+			return xSemaphoreTakeFromISR(handle, nullptr) == pdTRUE;
+		}
+
+		/**
+		 * @brief Release an obtained mutex from interrupt context.
+		 *
+		 * @param[out] woken	[Optional] Set to pdTRUE if a context
+		 *			switch should be requested before the
+		 *			interrupt exits.
+		 *
+		 * @return true if success,
+		 * false if no mutex was obtained before.
+		 */
+		bool UnlockFromISR(BaseType_t *woken = nullptr) {
+			return xSemaphoreGiveFromISR(handle, woken) == pdTRUE;
+		}
 	};
 
-#if (INCLUDE_vTaskDelay == 1)
+#if (FREERTOS_LOCK_PROFILING == 1)
 	/**
-	 * @brief Suspend the task execution for given amount of milliseconds.
+	 * @brief Enumerates every live Mutex and semaphore and reports their
+	 * contention statistics.
 	 *
-	 * @param[in] ms		Amount of milliseconds to wait.
+	 * ISR variants (LockFromISR, GiveFromISR...) are not profiled.
 	 */
-	static inline void Delay_ms(size_t ms) {
-		vTaskDelay(pdMS_TO_TICKS(ms));
-	}
-#endif /* INCLUDE_vTaskDelay */
+	class LockRegistry
+	{
+	public:
+		/**
+		 * @brief Copy statistics of all live locks, sorted in
+		 * descending order.
+		 *
+		 * @param[out] out	Destination array.
+		 * @param[in] max	Size of destination array.
+		 * @param[in] key	[Optional] Field used for sorting.
+		 *
+		 * @return Number of entries copied.
+		 */
+		static size_t Snapshot(LockStats *out, size_t max,
+			uint32_t LockStats::*key = &LockStats::wait_total) {
+			size_t n = 0;
+
+			vTaskSuspendAll();
+			for (Mutex *m = Mutex::lock_list; m && n < max;
+			     m = m->next_lock) {
+				taskENTER_CRITICAL();
+				out[n++] = m->stats;
+				taskEXIT_CRITICAL();
+			}
+			xTaskResumeAll();
+
+			for (size_t i = 1; i < n; i++) {
+				LockStats tmp = out[i];
+				size_t j = i;
+				for (; j && out[j - 1].*key < tmp.*key; j--)
+					out[j] = out[j - 1];
+				out[j] = tmp;
+			}
+			return n;
+		}
+
+		/**
+		 * @brief Print a sorted report, one line per lock.
+		 *
+		 * @tparam max		[Optional] Maximum amount of lines,
+		 *			the snapshot is kept on the stack.
+		 *
+		 * @param[in] print	Function to output a single line.
+		 * @param[in] key	[Optional] Field used for sorting.
+		 */
+		template <size_t max = 16>
+		static void Dump(void (*print)(const char *line),
+			uint32_t LockStats::*key = &LockStats::wait_total) {
+			LockStats list[max];
+			char line[128];
+			size_t n = Snapshot(list, max, key);
+
+			print("name             acq      cont     wait_sum "
+			      "wait_max hold_sum hold_max owner");
+			for (size_t i = 0; i != n; i++) {
+				const LockStats &s = list[i];
+				snprintf(line, sizeof(line),
+				         "%-16s %-8lu %-8lu %-8lu %-8lu %-8lu "
+				         "%-8lu %s",
+				         s.name ? s.name : "-",
+				         (unsigned long)s.acquisitions,
+				         (unsigned long)s.contentions,
+				         (unsigned long)s.wait_total,
+				         (unsigned long)s.wait_max,
+				         (unsigned long)s.hold_total,
+				         (unsigned long)s.hold_max,
+				         s.last_owner);
+				print(line);
+			}
+		}
+
+		/**
+		 * @brief Clear statistics of all live locks.
+		 */
+		static void Reset() {
+			vTaskSuspendAll();
+			for (Mutex *m = Mutex::lock_list; m; m = m->next_lock) {
+				taskENTER_CRITICAL();
+				const char *name = m->stats.name;
+				m->stats = LockStats();
+				m->stats.name = name;
+				m->owner = nullptr;
+				taskEXIT_CRITICAL();
+			}
+			xTaskResumeAll();
+		}
+	};
+#endif /* FREERTOS_LOCK_PROFILING */
 
-#if (INCLUDE_vTaskDelayUntil == 1)
 	/**
-	 * @brief Enables accurate periodic execution.
+	 * @brief Create binary semaphore.
 	 */
-	class TimerDelay
+	class BinarySemaphore : public Mutex
 	{
+	private:
+		using Mutex::Lock;
+		using Mutex::LockFromISR;
+		using Mutex::Unlock;
+		using Mutex::UnlockFromISR;
 	protected:
-		TickType_t xLastWakeTime = 0;
+		/**
+		 * @brief See Mutex::Mutex(const char *, Uncreated)
+		 */
+		BinarySemaphore(const char *name, Uncreated)
+			: Mutex(name, Uncreated()) {}
+
+#if (FREERTOS_DEFERRED_INIT == 1)
+		constexpr BinarySemaphore(DeferredInit, const char *name,
+		                          Uncreated)
+			: Mutex(Deferred, name) {}
+#endif /* FREERTOS_DEFERRED_INIT */
+
+		void CreateBinary() {
+#if (configSUPPORT_STATIC_ALLOCATION == 1)
+			handle = xSemaphoreCreateBinaryStatic(&buffer);
+#else /* STATIC_ALLOCATION */
+			handle = xSemaphoreCreateBinary();
+			configASSERT(handle != nullptr);
+#endif /* STATIC_ALLOCATION */
+		}
 	public:
 		/**
-		 * @brief Constructor of TimerDelay class.
+		 * @brief Create a binary semaphore.
+		 */
+		BinarySemaphore() : BinarySemaphore(nullptr) {}
+
+		/**
+		 * @brief Create a named binary semaphore.
 		 *
-		 * @param start		Initiate at the moment of creation if enabled.
+		 * @param[in] name	Name used by profiling and tracing
+		 *			reports.
 		 */
-		TimerDelay(bool start = true) {
-			if (start)
-				Reset();
+		explicit BinarySemaphore(const char *name)
+			: Mutex(name, Uncreated()) {
+			CreateBinary();
 		}
 
+#if (FREERTOS_DEFERRED_INIT == 1)
 		/**
-		 * @brief Reset the time stamp value.
+		 * @brief Constant initialize without creating the semaphore.
+		 *
+		 * @param[in] name	[Optional] Name used by profiling and
+		 *			tracing reports.
 		 */
-		void Reset() {
-			xLastWakeTime = xTaskGetTickCount();
+		constexpr explicit BinarySemaphore(DeferredInit,
+		                                   const char *name = nullptr)
+			: Mutex(Deferred, name) {}
+
+		/**
+		 * @brief Create the semaphore of a deferred object.
+		 */
+		void Init() {
+			configASSERT(handle == nullptr);
+			Setup(init_name);
+			CreateBinary();
+		}
+#endif /* FREERTOS_DEFERRED_INIT */
+
+		/**
+		 * @brief Give semaphore.
+		 *
+		 * @return true if given, false if already given before.
+		 */
+		inline bool Give() {
+			return Mutex::Unlock();
+		}
+
+		/**
+		 * @brief Wait for semaphore to be given.
+		 *
+		 * @param[in] wait_ms	[Optional] Time to wait in [ms].
+		 *
+		 * @return true if semaphore obtained successfully, false
+		 * on timeout.
+		 */
+		inline bool Take(size_t wait_ms = WAIT_MAX) {
+			return Mutex::Lock(wait_ms);
+		}
+
+		/**
+		 * @brief Wait for semaphore to be given unless stop is
+		 * requested.
+		 *
+		 * A stop request gives the semaphore to wake the caller, the
+		 * count is taken back before returning. Meant for semaphores
+		 * with a single taking task.
+		 *
+		 * @param[in] wait_ms	Time to wait in [ms].
+		 * @param[in] token	Stop token to observe.
+		 *
+		 * @return true if semaphore obtained, false on timeout or stop.
+		 */
+		inline bool Take(size_t wait_ms, const StopToken &token) {
+			std::atomic<bool> stop_given {false};
+
+			bool taken = token.Wait(wait_ms,
+				[this, &stop_given] { stop_given = Give(); },
+				[this, &stop_given](size_t ms) {
+					return Take(ms) && !stop_given.exchange(false);
+				});
+			/* Given for stop after a real give was taken */
+			if (stop_given)
+				Take(0);
+			return taken;
+		}
+
+		/**
+		 * @brief Give semaphore from ISR.
+		 *
+		 * @param[out] woken	[Optional] Set to pdTRUE if a context
+		 *			switch should be requested before the
+		 *			interrupt exits.
+		 *
+		 * @return true if given, false if already given before.
+		 */
+		inline bool GiveFromISR(BaseType_t *woken = nullptr) {
+			return Mutex::UnlockFromISR(woken);
+		}
+
+		/**
+		 * @brief Wait for semaphore to be given from ISR.
+		 *
+		 * @return true if semaphore obtained successfully, false
+		 * on timeout.
+		 */
+		inline bool TakeFromISR() {
+			return Mutex::LockFromISR();
+		}
+	};
+
+	/**
+	 * @brief Create counting semaphore.
+	 */
+	class CountingSemaphore : public BinarySemaphore
+	{
+	protected:
+#if (FREERTOS_DEFERRED_INIT == 1)
+		size_t init_count = 0;
+		size_t init_max = 0;
+#endif /* FREERTOS_DEFERRED_INIT */
+
+		void CreateCounting(size_t initial, size_t max) {
+#if (configSUPPORT_STATIC_ALLOCATION == 1)
+			handle = xSemaphoreCreateCountingStatic(max, initial,
+			                                        &buffer);
+#else /* STATIC_ALLOCATION */
+			handle = xSemaphoreCreateCounting(max, initial);
+			configASSERT(handle != nullptr);
+#endif /* STATIC_ALLOCATION */
+		}
+	public:
+		/**
+		 * @brief Create counting semaphore with initial count and max
+		 * value.
+		 *
+		 * @param[in] initial		Initial count value.
+		 * @param[in] max		The maximum count value that can
+		 *				be reached. When the semaphore
+		 *				reaches this value it can no
+		 *				longer be 'given'.
+		 * @param[in] name		[Optional] Name used by
+		 *				profiling and tracing reports.
+		 */
+		CountingSemaphore(size_t initial = 0, size_t max = 100,
+		                  const char *name = nullptr)
+			: BinarySemaphore(name, Uncreated()) {
+			CreateCounting(initial, max);
+		}
+
+#if (FREERTOS_DEFERRED_INIT == 1)
+		/**
+		 * @brief Constant initialize without creating the semaphore.
+		 *
+		 * @param[in] initial		Initial count value.
+		 * @param[in] max		The maximum count value.
+		 * @param[in] name		[Optional] Name used by
+		 *				profiling and tracing reports.
+		 */
+		constexpr CountingSemaphore(DeferredInit, size_t initial = 0,
+		                            size_t max = 100,
+		                            const char *name = nullptr)
+			: BinarySemaphore(Deferred, name, Uncreated()),
+			  init_count(initial), init_max(max) {}
+
+		/**
+		 * @brief Create the semaphore of a deferred object.
+		 */
+		void Init() {
+			configASSERT(handle == nullptr);
+			Setup(init_name);
+			CreateCounting(init_count, init_max);
+		}
+#endif /* FREERTOS_DEFERRED_INIT */
+
+		/**
+		 * @brief Read current count value.
+		 *
+		 * @return Count value.
+		 */
+		FREERTOS_NODISCARD
+		size_t GetCount() {
+			return uxSemaphoreGetCount(handle);
+		}
+	};
+
+#if !defined(configUSE_EVENT_GROUPS) || (configUSE_EVENT_GROUPS == 1)
+	/**
+	 * @brief Type safe set of event group bits.
+	 *
+	 * @tparam E		Enumeration type, each enumerator is a bit
+	 *			number (0, 1, 2...), not a mask.
+	 */
+	template <class E>
+	class Flags
+	{
+		static_assert(std::is_enum<E>::value, "E must be an enum");
+	protected:
+		EventBits_t bits = 0;
+
+		static void InvalidFlag() {
+			configASSERT(0);
+		}
+
+		static constexpr EventBits_t Bit(E flag) {
+			return static_cast<unsigned>(flag) < max_bits ?
+				(EventBits_t)1 << static_cast<unsigned>(flag) :
+				(InvalidFlag(), 0);
+		}
+	public:
+		/**
+		 * @brief Amount of bits available to the user, the upper
+		 * 8 bits of event group are reserved by the kernel.
+		 */
+		static constexpr unsigned max_bits =
+			sizeof(EventBits_t) * 8 - 8;
+
+		/**
+		 * @brief Create empty set.
+		 */
+		constexpr Flags() {}
+
+		/**
+		 * @brief Create set of flags. Out of range flags fail to
+		 * compile when used in constant expression.
+		 *
+		 * @param[in] flag	First flag.
+		 * @param[in] rest	[Optional] Other flags, all of type E.
+		 */
+		template <class... Rest, class = typename std::enable_if<
+			(std::is_same<Rest, E>::value && ...)>::type>
+		constexpr Flags(E flag, Rest... rest)
+			: bits((Bit(flag) | ... | Bit(rest))) {}
+
+		/**
+		 * @brief Create set of flags checked at compile time.
+		 */
+		template <E... flags>
+		static constexpr Flags Of() {
+			static_assert(((static_cast<unsigned>(flags) <
+			                max_bits) && ...),
+			              "Flag does not fit into event group");
+			return Flags(flags...);
+		}
+
+		/**
+		 * @brief Create set from raw event group bits.
+		 */
+		static constexpr Flags FromBits(EventBits_t bits) {
+			Flags f;
+			f.bits = bits & (((EventBits_t)1 << max_bits) - 1);
+			return f;
+		}
+
+		/**
+		 * @brief Raw event group bits.
+		 */
+		constexpr EventBits_t Bits() const {
+			return bits;
+		}
+
+		/**
+		 * @brief Check if flag is in the set.
+		 */
+		constexpr bool Has(E flag) const {
+			return bits & Bit(flag);
+		}
+
+		/**
+		 * @brief Check if set has all flags of another set.
+		 */
+		constexpr bool HasAll(Flags f) const {
+			return (bits & f.bits) == f.bits;
+		}
+
+		/**
+		 * @brief Check if set is empty.
+		 */
+		constexpr bool Empty() const {
+			return bits == 0;
+		}
+
+		constexpr Flags operator|(Flags f) const {
+			return FromBits(bits | f.bits);
+		}
+
+		constexpr Flags operator&(Flags f) const {
+			return FromBits(bits & f.bits);
+		}
+
+		constexpr bool operator==(Flags f) const {
+			return bits == f.bits;
+		}
+
+		constexpr bool operator!=(Flags f) const {
+			return bits != f.bits;
+		}
+	};
+
+	/**
+	 * @brief FreeRTOS event group with type safe flags.
+	 *
+	 * A single event group lets a task wait for any or all of several
+	 * conditions with one wake-up.
+	 *
+	 * @tparam E		Enumeration type, each enumerator is a bit
+	 *			number.
+	 */
+	template <class E>
+	class EventGroup
+	{
+	protected:
+#if (configSUPPORT_STATIC_ALLOCATION == 1)
+		StaticEventGroup_t buffer;
+#endif /* STATIC_ALLOCATION */
+		EventGroupHandle_t handle = nullptr;
+	public:
+		using Set_t = Flags<E>;
+
+		/**
+		 * @brief Creates an event group with all bits cleared.
+		 */
+		EventGroup() {
+#if (configSUPPORT_STATIC_ALLOCATION == 1)
+			handle = xEventGroupCreateStatic(&buffer);
+#else /* STATIC_ALLOCATION */
+			handle = xEventGroupCreate();
+#endif /* STATIC_ALLOCATION */
+			configASSERT(handle != nullptr);
+		}
+
+		/**
+		 * @brief Deletes the event group, tasks waiting for it are
+		 * unblocked.
+		 */
+		~EventGroup() {
+			if (handle)
+				vEventGroupDelete(handle);
+			handle = nullptr;
+		}
+
+		/**
+		 * @brief Prevent class to be copied.
+		 */
+		EventGroup(const EventGroup &) = delete;
+
+		/**
+		 * @brief Set flags and unblock tasks waiting for them.
+		 *
+		 * @param[in] flags	Flags to set.
+		 *
+		 * @return Flags set at the time the call returns.
+		 */
+		Set_t Set(Set_t flags) {
+			return Set_t::FromBits(
+				xEventGroupSetBits(handle, flags.Bits()));
+		}
+
+#if (configUSE_TIMERS == 1) && (INCLUDE_xTimerPendFunctionCall == 1)
+		/**
+		 * @brief Set flags from interrupt context. The operation is
+		 * deferred to the timer daemon task.
+		 *
+		 * @param[in] flags	Flags to set.
+		 * @param[out] woken	[Optional] Set to pdTRUE if a context
+		 *			switch should be requested before the
+		 *			interrupt exits.
+		 *
+		 * @return true if request is posted, false if timer command
+		 * queue is full.
+		 */
+		bool SetFromISR(Set_t flags, BaseType_t *woken = nullptr) {
+			return xEventGroupSetBitsFromISR(handle, flags.Bits(),
+			                                 woken) == pdPASS;
+		}
+#endif /* configUSE_TIMERS */
+
+		/**
+		 * @brief Clear flags.
+		 *
+		 * @param[in] flags	Flags to clear.
+		 *
+		 * @return Flags set before they were cleared.
+		 */
+		Set_t Clear(Set_t flags) {
+			return Set_t::FromBits(
+				xEventGroupClearBits(handle, flags.Bits()));
+		}
+
+		/**
+		 * @brief Read current flags.
+		 */
+		FREERTOS_NODISCARD
+		Set_t Get() {
+			return Set_t::FromBits(xEventGroupGetBits(handle));
+		}
+
+		/**
+		 * @brief Read current flags from interrupt context.
+		 */
+		FREERTOS_NODISCARD
+		Set_t GetFromISR() {
+			return Set_t::FromBits(xEventGroupGetBitsFromISR(handle));
+		}
+
+		/**
+		 * @brief Wait for any of the flags to be set.
+		 *
+		 * @param[in] flags	Flags to wait for.
+		 * @param[in] wait_ms	[Optional] Time to wait in [ms].
+		 * @param[in] clear	[Optional] Clear received flags.
+		 *
+		 * @return Requested flags that are set, empty on timeout.
+		 */
+		Set_t WaitAny(Set_t flags, size_t wait_ms = WAIT_MAX,
+		              bool clear = true) {
+			return flags & Set_t::FromBits(xEventGroupWaitBits(
+				handle, flags.Bits(), clear, pdFALSE,
+				pdMS_TO_TICKS(wait_ms)));
+		}
+
+		/**
+		 * @brief Wait for all the flags to be set.
+		 *
+		 * @param[in] flags	Flags to wait for.
+		 * @param[in] wait_ms	[Optional] Time to wait in [ms].
+		 * @param[in] clear	[Optional] Clear flags on success.
+		 *
+		 * @return true if all flags were set, false on timeout.
+		 */
+		bool WaitAll(Set_t flags, size_t wait_ms = WAIT_MAX,
+		             bool clear = true) {
+			return Set_t::FromBits(xEventGroupWaitBits(handle,
+				flags.Bits(), clear, pdTRUE,
+				pdMS_TO_TICKS(wait_ms))).HasAll(flags);
+		}
+
+		/**
+		 * @brief Atomically set flags and wait for all the flags
+		 * (rendezvous). Waited flags are cleared on success.
+		 *
+		 * @param[in] set	Flags to set.
+		 * @param[in] wait_for	Flags to wait for.
+		 * @param[in] wait_ms	[Optional] Time to wait in [ms].
+		 *
+		 * @return true if all flags were set, false on timeout.
+		 */
+		bool Sync(Set_t set, Set_t wait_for,
+		          size_t wait_ms = WAIT_MAX) {
+			return Set_t::FromBits(xEventGroupSync(handle,
+				set.Bits(), wait_for.Bits(),
+				pdMS_TO_TICKS(wait_ms))).HasAll(wait_for);
+		}
+	};
+#endif /* configUSE_EVENT_GROUPS */
+
+	/**
+	 * @brief Type erased callable stored inside the object.
+	 *
+	 * Unlike std::function it never allocates, a callable that does not
+	 * fit into the storage fails to compile.
+	 *
+	 * @tparam Signature	Function signature, e.g. void().
+	 * @tparam size		Storage size in bytes.
+	 */
+	template <class Signature, size_t size = 4 * sizeof(void *)>
+	class InlineFunction;
+
+	template <class R, class... Args, size_t size>
+	class InlineFunction<R(Args...), size>
+	{
+	protected:
+		alignas(std::max_align_t) unsigned char storage[size ? size : 1];
+		R (*invoke)(void *, Args...) = nullptr;
+		void (*destroy)(void *) = nullptr;
+	public:
+		/**
+		 * @brief Check at compile time if callable fits the storage.
+		 */
+		template <class F>
+		static constexpr bool fits = sizeof(F) <= size &&
+			alignof(F) <= alignof(std::max_align_t);
+
+		/**
+		 * @brief Create empty function.
+		 */
+		constexpr InlineFunction() : storage() {}
+
+		/**
+		 * @brief Create function from a callable.
+		 */
+		template <class F, class = typename std::enable_if<
+			!std::is_same<typename std::decay<F>::type,
+			              InlineFunction>::value>::type>
+		InlineFunction(F &&f) {
+			Emplace(std::forward<F>(f));
+		}
+
+		/**
+		 * @brief Prevent class to be copied or moved.
+		 */
+		InlineFunction(const InlineFunction &) = delete;
+		InlineFunction(InlineFunction &&) = delete;
+
+		~InlineFunction() {
+			Reset();
+		}
+
+		/**
+		 * @brief Store a callable, previous one is destroyed.
+		 *
+		 * @param[in] f		Callable object.
+		 */
+		template <class F>
+		void Emplace(F &&f) {
+			using Fn = typename std::decay<F>::type;
+			static_assert(fits<Fn>,
+				"Callable does not fit into inline storage");
+
+			Reset();
+			new (storage) Fn(std::forward<F>(f));
+			invoke = [](void *p, Args... args) -> R {
+				return (*static_cast<Fn *>(p))(
+					std::forward<Args>(args)...);
+			};
+			if (!std::is_trivially_destructible<Fn>::value)
+				destroy = [](void *p) {
+					static_cast<Fn *>(p)->~Fn();
+				};
+		}
+
+		/**
+		 * @brief Destroy stored callable.
+		 */
+		void Reset() {
+			if (destroy)
+				destroy(storage);
+			invoke = nullptr;
+			destroy = nullptr;
+		}
+
+		/**
+		 * @brief Call stored callable, must not be empty.
+		 */
+		R operator()(Args... args) {
+			return invoke(storage, std::forward<Args>(args)...);
+		}
+
+		/**
+		 * @brief Check if a callable is stored.
+		 */
+		explicit operator bool() const {
+			return invoke != nullptr;
+		}
+	};
+
+#if (configUSE_TIMERS == 1) && (INCLUDE_xTimerPendFunctionCall == 1)
+	/**
+	 * @brief Moves work out of interrupts into the timer daemon task.
+	 *
+	 * Callables with their captures are stored in a static pool of
+	 * FREERTOS_DEFER_SLOTS slots, so no heap is used. The daemon task runs
+	 * at configTIMER_TASK_PRIORITY, which should be high enough for the
+	 * deferred work.
+	 */
+	class Defer
+	{
+		/* Only used in the static pool, which is zero initialized. */
+		struct Slot
+		{
+			std::atomic<bool> busy;
+			InlineFunction<void(), FREERTOS_DEFER_SIZE> fn;
+		};
+
+		static inline Slot slots[FREERTOS_DEFER_SLOTS];
+
+		static Slot *Claim() {
+			for (Slot &slot : slots)
+				if (!slot.busy.exchange(true,
+				                        std::memory_order_acquire))
+					return &slot;
+			return nullptr;
+		}
+
+		static void Release(Slot *slot) {
+			slot->fn.Reset();
+			slot->busy.store(false, std::memory_order_release);
+		}
+
+		static void Run(void *param, uint32_t) {
+			Slot *slot = static_cast<Slot *>(param);
+
+			slot->fn();
+			Release(slot);
+		}
+
+		template <class F>
+		static Slot *Prepare(F &&fn) {
+			Slot *slot = Claim();
+
+			if (slot)
+				slot->fn.Emplace(std::forward<F>(fn));
+			return slot;
+		}
+	public:
+		/**
+		 * @brief Run a callable in the daemon task, call from an
+		 * interrupt.
+		 *
+		 * @param[in] fn	Callable, captures must fit into
+		 *			FREERTOS_DEFER_SIZE bytes.
+		 * @param[out] woken	[Optional] Set to pdTRUE if a context
+		 *			switch should be requested before the
+		 *			interrupt exits.
+		 *
+		 * @return true if posted, false if all slots are in use or the
+		 * timer command queue is full.
+		 */
+		template <class F>
+		static bool FromISR(F &&fn, BaseType_t *woken = nullptr) {
+			Slot *slot = Prepare(std::forward<F>(fn));
+
+			if (!slot)
+				return false;
+			if (xTimerPendFunctionCallFromISR(Run, slot, 0,
+			                                  woken) != pdPASS) {
+				Release(slot);
+				return false;
+			}
+			return true;
+		}
+
+		/**
+		 * @brief Run a callable in the daemon task, call from a task.
+		 *
+		 * @param[in] fn	Callable, captures must fit into
+		 *			FREERTOS_DEFER_SIZE bytes.
+		 * @param[in] wait_ms	[Optional] Time to wait for space in
+		 *			the timer command queue in [ms].
+		 *
+		 * @return true if posted, false if all slots are in use or the
+		 * timer command queue is full.
+		 */
+		template <class F>
+		static bool Call(F &&fn, size_t wait_ms = 0) {
+			Slot *slot = Prepare(std::forward<F>(fn));
+
+			if (!slot)
+				return false;
+			if (xTimerPendFunctionCall(Run, slot, 0,
+			                           pdMS_TO_TICKS(wait_ms)) != pdPASS) {
+				Release(slot);
+				return false;
+			}
+			return true;
+		}
+
+		/**
+		 * @brief Get number of requests not yet executed.
+		 */
+		FREERTOS_NODISCARD
+		static size_t Pending() {
+			size_t n = 0;
+
+			for (const Slot &slot : slots)
+				n += slot.busy.load(std::memory_order_relaxed);
+			return n;
+		}
+	};
+#endif /* configUSE_TIMERS */
+
+#if (FREERTOS_STACK_MONITOR == 1)
+	/**
+	 * @brief Registry of all live tasks, tracking the lowest amount of
+	 * free stack ever seen for each of them.
+	 *
+	 * Sample() is meant to be called periodically, e.g. from a Timer.
+	 * Tasks register themselves, no manual setup is needed.
+	 */
+	class StackMonitor
+	{
+		static_assert(INCLUDE_uxTaskGetStackHighWaterMark == 1,
+			"StackMonitor requires uxTaskGetStackHighWaterMark");
+	public:
+		/**
+		 * @brief Stack usage of a single task. Sizes are in words.
+		 */
+		struct Entry
+		{
+			TaskHandle_t handle = nullptr;
+			size_t size = 0;
+			size_t min_free = 0;
+			Entry *next = nullptr;
+		};
+
+		/**
+		 * @brief Stack usage report line. Sizes are in words.
+		 */
+		struct Usage
+		{
+			const char *name;
+			size_t size;
+			size_t used;
+			size_t recommended;
+		};
+
+		static void Register(Entry *e, TaskHandle_t handle,
+		                     size_t size) {
+			e->handle = handle;
+			e->size = size;
+			e->min_free = size;
+			vTaskSuspendAll();
+			e->next = list;
+			list = e;
+			xTaskResumeAll();
+		}
+
+		static void Unregister(Entry *e) {
+			vTaskSuspendAll();
+			for (Entry **p = &list; *p; p = &(*p)->next) {
+				if (*p == e) {
+					*p = e->next;
+					break;
+				}
+			}
+			xTaskResumeAll();
+		}
+
+		/**
+		 * @brief Read the high water mark of every registered task.
+		 */
+		static void Sample() {
+			vTaskSuspendAll();
+			for (Entry *e = list; e; e = e->next) {
+				size_t left = uxTaskGetStackHighWaterMark(e->handle);
+				if (left < e->min_free)
+					e->min_free = left;
+			}
+			xTaskResumeAll();
+		}
+
+		/**
+		 * @brief Stack size recommended for a measured usage.
+		 *
+		 * @param[in] used	Maximum amount of words used.
+		 *
+		 * @return Usage plus FREERTOS_STACK_MARGIN percent, rounded up
+		 * to FREERTOS_STACK_ROUND, never below
+		 * configMINIMAL_STACK_SIZE.
+		 */
+		static constexpr size_t Recommend(size_t used) {
+			size_t size = used + (used * FREERTOS_STACK_MARGIN + 99) / 100;
+			size = (size + FREERTOS_STACK_ROUND - 1) /
+				FREERTOS_STACK_ROUND * FREERTOS_STACK_ROUND;
+			return size < (size_t)configMINIMAL_STACK_SIZE ?
+				(size_t)configMINIMAL_STACK_SIZE : size;
+		}
+
+		/**
+		 * @brief Sample and copy usage of all registered tasks.
+		 *
+		 * @param[out] out	Destination array.
+		 * @param[in] max	Size of destination array.
+		 *
+		 * @return Number of entries copied.
+		 */
+		static size_t Snapshot(Usage *out, size_t max) {
+			size_t n = 0;
+
+			Sample();
+			vTaskSuspendAll();
+			for (Entry *e = list; e && n < max; e = e->next) {
+				size_t used = e->size - e->min_free;
+				out[n++] = { pcTaskGetName(e->handle), e->size,
+				             used, Recommend(used) };
+			}
+			xTaskResumeAll();
+			return n;
+		}
+
+		/**
+		 * @brief Print a CSV report, one line per task:
+		 * "task,stack_size,used,recommended".
+		 *
+		 * @tparam max		[Optional] Maximum amount of lines,
+		 *			the snapshot is kept on the stack.
+		 *
+		 * @param[in] print	Function to output a single line.
+		 */
+		template <size_t max = 16>
+		static void Dump(void (*print)(const char *line)) {
+			Usage list[max];
+			char line[64];
+			size_t n = Snapshot(list, max);
+
+			print("task,stack_size,used,recommended");
+			for (size_t i = 0; i != n; i++) {
+				snprintf(line, sizeof(line), "%s,%lu,%lu,%lu",
+				         list[i].name,
+				         (unsigned long)list[i].size,
+				         (unsigned long)list[i].used,
+				         (unsigned long)list[i].recommended);
+				print(line);
+			}
+		}
+	private:
+		static inline Entry *list = nullptr;
+	};
+#endif /* FREERTOS_STACK_MONITOR */
+
+	/**
+	 * @brief Registry of task heartbeats. Each monitored task owns a
+	 * Heartbeat and kicks it, Check() reports the ones which stayed silent
+	 * longer than their deadline.
+	 */
+	class Watchdog
+	{
+	public:
+		/**
+		 * @brief Report of a stalled task.
+		 */
+		struct Stall
+		{
+			const char *name;
+			TaskHandle_t handle;
+#if (INCLUDE_eTaskGetState == 1)
+			eTaskState state;
+#endif /* INCLUDE_eTaskGetState */
+#if (INCLUDE_uxTaskGetStackHighWaterMark == 1)
+			/** Minimum amount of free stack words. */
+			size_t stack_free;
+#endif /* INCLUDE_uxTaskGetStackHighWaterMark */
+			/** Time since the last observed kick in [ms]. */
+			uint32_t silent_ms;
+			uint32_t deadline_ms;
+		};
+
+		/**
+		 * @brief Registration of a single task. Kicks are only
+		 * observed by Check(), so the deadline resolution is the
+		 * checking period.
+		 */
+		class Heartbeat
+		{
+			friend class Watchdog;
+			std::atomic<bool> kicked {true};
+			TaskHandle_t handle;
+			TickType_t deadline;
+			TickType_t last_seen;
+			bool reported = false;
+			Heartbeat *next = nullptr;
+		public:
+			/**
+			 * @brief Register a task.
+			 *
+			 * @param[in] deadline_ms	Maximum time between
+			 *				kicks in [ms].
+			 * @param[in] task		[Optional] Monitored task,
+			 *				the calling one by default.
+			 */
+			explicit Heartbeat(size_t deadline_ms,
+			                   TaskHandle_t task = nullptr)
+				: handle(task ? task :
+				         xTaskGetCurrentTaskHandle()),
+				  deadline(pdMS_TO_TICKS(deadline_ms)),
+				  last_seen(xTaskGetTickCount()) {
+				configASSERT(handle != nullptr);
+				Register(this);
+			}
+
+			~Heartbeat() {
+				Unregister(this);
+			}
+
+			/**
+			 * @brief Signal the task is alive, a single atomic
+			 * store.
+			 */
+			void Kick() {
+				kicked.store(true, std::memory_order_relaxed);
+			}
+
+			/**
+			 * @brief Prevent class to be copied.
+			 */
+			Heartbeat(const Heartbeat &) = delete;
+		};
+
+		/**
+		 * @brief Find tasks which missed their deadline. Does not
+		 * block, so it can also run from the idle hook.
+		 *
+		 * @param[in] report	[Optional] Called once per stall with
+		 *			the scheduler suspended, must not block.
+		 *
+		 * @return Number of currently stalled tasks.
+		 */
+		static size_t Check(void (*report)(const Stall &stall) = nullptr) {
+			size_t stalled = 0;
+
+			vTaskSuspendAll();
+			TickType_t now = xTaskGetTickCount();
+			for (Heartbeat *e = list; e; e = e->next) {
+				if (e->kicked.exchange(false,
+				                       std::memory_order_relaxed)) {
+					e->last_seen = now;
+					e->reported = false;
+					continue;
+				}
+				TickType_t silent = now - e->last_seen;
+				if (silent <= e->deadline)
+					continue;
+				stalled++;
+				if (!report || e->reported)
+					continue;
+				e->reported = true;
+				Stall stall;
+				stall.name = pcTaskGetName(e->handle);
+				stall.handle = e->handle;
+#if (INCLUDE_eTaskGetState == 1)
+				stall.state = eTaskGetState(e->handle);
+#endif /* INCLUDE_eTaskGetState */
+#if (INCLUDE_uxTaskGetStackHighWaterMark == 1)
+				stall.stack_free =
+					uxTaskGetStackHighWaterMark(e->handle);
+#endif /* INCLUDE_uxTaskGetStackHighWaterMark */
+				stall.silent_ms = (uint32_t)((uint64_t)silent *
+					1000 / configTICK_RATE_HZ);
+				stall.deadline_ms = (uint32_t)((uint64_t)e->deadline *
+					1000 / configTICK_RATE_HZ);
+				report(stall);
+			}
+			xTaskResumeAll();
+			return stalled;
+		}
+
+		/**
+		 * @brief Drop all heartbeats of a task about to be deleted,
+		 * they may live on its stack. Task does this on deletion,
+		 * call it before deleting a task with vTaskDelete().
+		 *
+		 * @param[in] task	Task being deleted.
+		 */
+		static void Forget(TaskHandle_t task) {
+			vTaskSuspendAll();
+			for (Heartbeat **p = &list; *p;) {
+				if ((*p)->handle == task)
+					*p = (*p)->next;
+				else
+					p = &(*p)->next;
+			}
+			xTaskResumeAll();
+		}
+	private:
+		static inline Heartbeat *list = nullptr;
+
+		static void Register(Heartbeat *e) {
+			vTaskSuspendAll();
+			e->next = list;
+			list = e;
+			xTaskResumeAll();
+		}
+
+		static void Unregister(Heartbeat *e) {
+			vTaskSuspendAll();
+			for (Heartbeat **p = &list; *p; p = &(*p)->next) {
+				if (*p == e) {
+					*p = e->next;
+					break;
+				}
+			}
+			xTaskResumeAll();
+		}
+	};
+
+#if (configGENERATE_RUN_TIME_STATS == 1) && (configUSE_TRACE_FACILITY == 1)
+	/**
+	 * @brief CPU usage of a single task over a sampling window.
+	 */
+	struct TaskLoad
+	{
+		const char *name;
+		TaskHandle_t handle;
+		UBaseType_t priority;
+		/** CPU usage in percent of one core. */
+		uint8_t cpu;
+		/** Run time counter increase over the window. */
+		uint32_t run_time;
+		/** Times the task was switched in over the window. */
+		uint32_t switches;
+	};
+
+	/**
+	 * @brief Per task CPU usage based on the kernel run time counters.
+	 *
+	 * Every Update() samples all tasks and compares the counters with
+	 * the sample taken 'window' updates before, so the result is a
+	 * sliding average. Call it periodically, e.g. once per second.
+	 *
+	 * @tparam max_tasks	[Optional] Maximum number of tasks in system.
+	 * @tparam window	[Optional] Number of updates averaged.
+	 */
+	template <size_t max_tasks = 16, size_t window = 4>
+	class RuntimeStats
+	{
+		static_assert(window > 0, "Window must cover at least one update");
+#if (FREERTOS_CONTEXT_SWITCH_COUNT == 1)
+		static_assert(FREERTOS_CONTEXT_SWITCH_TLS_INDEX <
+			configNUM_THREAD_LOCAL_STORAGE_POINTERS,
+			"No thread local storage pointer for switch counter");
+#endif /* FREERTOS_CONTEXT_SWITCH_COUNT */
+	public:
+		/**
+		 * @brief Result of the last update.
+		 */
+		struct Snapshot
+		{
+			TaskLoad tasks[max_tasks];
+			/** Number of valid entries in tasks. */
+			size_t count;
+			/** Total CPU load in percent, averaged over cores. */
+			uint8_t load;
+			/** Run time counter increase over the window. */
+			uint32_t elapsed;
+			/** Context switches over the window. */
+			uint32_t switches;
+		};
+	protected:
+		using Counter = decltype(TaskStatus_t::ulRunTimeCounter);
+		struct Sample
+		{
+			UBaseType_t id;
+			Counter run_time;
+			uint32_t switches;
+		};
+		TaskStatus_t status[max_tasks];
+		uint32_t switches[max_tasks];
+		Sample history[window][max_tasks];
+		size_t history_count[window] = {};
+		Counter history_total[window] = {};
+		size_t head = 0;
+		size_t filled = 0;
+		Snapshot last = {};
+
+		static bool IsIdle(const char *name) {
+#ifdef configIDLE_TASK_NAME
+			const char *idle = configIDLE_TASK_NAME;
+#else /* configIDLE_TASK_NAME */
+			const char *idle = "IDLE";
+#endif /* configIDLE_TASK_NAME */
+			return strncmp(name, idle, strlen(idle)) == 0;
+		}
+
+		const Sample *Find(size_t slot, UBaseType_t id) const {
+			for (size_t i = 0; i != history_count[slot]; i++)
+				if (history[slot][i].id == id)
+					return &history[slot][i];
+			return nullptr;
+		}
+	public:
+		RuntimeStats() = default;
+
+		/**
+		 * @brief Sample all tasks and compute usage over the window.
+		 *
+		 * @return true if updated, false if there are more than
+		 * max_tasks tasks and the previous snapshot is kept.
+		 */
+		bool Update() {
+			Counter total = 0;
+			size_t n;
+
+			vTaskSuspendAll();
+			n = uxTaskGetSystemState(status, max_tasks, &total);
+			for (size_t i = 0; i != n; i++) {
+#if (FREERTOS_CONTEXT_SWITCH_COUNT == 1)
+				switches[i] = (uint32_t)(uintptr_t)
+					pvTaskGetThreadLocalStoragePointer(
+						status[i].xHandle,
+						FREERTOS_CONTEXT_SWITCH_TLS_INDEX);
+#else /* FREERTOS_CONTEXT_SWITCH_COUNT */
+				switches[i] = 0;
+#endif /* FREERTOS_CONTEXT_SWITCH_COUNT */
+			}
+			xTaskResumeAll();
+			/* Zero means more tasks than max_tasks */
+			if (!n)
+				return false;
+
+			/* Oldest sample, or counters since boot */
+			size_t base = filled == window ? head : 0;
+			Counter elapsed = total -
+				(filled ? history_total[base] : 0);
+			uint32_t idle = 0;
+
+			last.count = n;
+			last.elapsed = (uint32_t)elapsed;
+			last.switches = 0;
+			for (size_t i = 0; i != n; i++) {
+				const Sample *prev = filled ?
+					Find(base, status[i].xTaskNumber) : nullptr;
+				Counter run = status[i].ulRunTimeCounter -
+					(prev ? prev->run_time : 0);
+				uint64_t cpu = elapsed ?
+					(uint64_t)run * 100 / elapsed : 0;
+				TaskLoad &t = last.tasks[i];
+
+				t.name = status[i].pcTaskName;
+				t.handle = status[i].xHandle;
+				t.priority = status[i].uxCurrentPriority;
+				t.cpu = cpu > 100 ? 100 : (uint8_t)cpu;
+				t.run_time = (uint32_t)run;
+				t.switches = switches[i] -
+					(prev ? prev->switches : 0);
+				last.switches += t.switches;
+				if (IsIdle(t.name))
+					idle += t.cpu;
+			}
+#ifdef configNUMBER_OF_CORES
+			idle /= configNUMBER_OF_CORES;
+#endif /* configNUMBER_OF_CORES */
+			last.load = idle > 100 ? 0 : (uint8_t)(100 - idle);
+
+			for (size_t i = 0; i != n; i++)
+				history[head][i] = { status[i].xTaskNumber,
+				                     status[i].ulRunTimeCounter,
+				                     switches[i] };
+			history_count[head] = n;
+			history_total[head] = total;
+			head = (head + 1) % window;
+			if (filled != window)
+				filled++;
+
+			return true;
+		}
+
+		/**
+		 * @brief Get result of the last update.
+		 */
+		FREERTOS_NODISCARD
+		const Snapshot &Get() const {
+			return last;
+		}
+
+		/**
+		 * @brief Print the last snapshot, one line per task.
+		 *
+		 * @param[in] print	Function to output a single line.
+		 */
+		void Dump(void (*print)(const char *line)) const {
+			char line[64];
+
+			snprintf(line, sizeof(line), "load %u%% switches %lu",
+			         last.load, (unsigned long)last.switches);
+			print(line);
+			for (size_t i = 0; i != last.count; i++) {
+				const TaskLoad &t = last.tasks[i];
+				snprintf(line, sizeof(line),
+				         "%-16s %3u%% %-8lu %lu",
+				         t.name, t.cpu,
+				         (unsigned long)t.switches,
+				         (unsigned long)t.run_time);
+				print(line);
+			}
+		}
+
+		/**
+		 * @brief Prevent class to be copied.
+		 */
+		RuntimeStats(const RuntimeStats &) = delete;
+	};
+#endif /* configGENERATE_RUN_TIME_STATS */
+
+	template <class T> class Promise;
+	template <class T> class Future;
+
+	/**
+	 * @brief Responsible for creating, control and delete FreeRTOS tasks.
+	 *
+	 * @tparam stack_size		[Optional] The number of words
+	 *				(not bytes) for use as the task's stack.
+	 * @tparam functor_size		[Optional] Size in bytes of storage
+	 *				for a callable task body.
+	 */
+	template <const size_t stack_size = FREERTOS_DEFAULT_TASK_STACK_SIZE,
+	          const size_t functor_size = FREERTOS_TASK_FUNCTOR_SIZE>
+	class Task
+	{
+	protected:
+		TaskHandle_t handle = nullptr;
+#if (configSUPPORT_STATIC_ALLOCATION == 1)
+		StackType_t xStack[stack_size];
+		StaticTask_t xTaskBuffer;
+#endif /* STATIC_ALLOCATION */
+		InlineFunction<void(), functor_size> body;
+		StopSource stop_source;
+		std::atomic<bool> finished {false};
+#if (FREERTOS_SYNC_NOTIFY == 1)
+		TaskHandle_t joiner = nullptr;
+#endif /* FREERTOS_SYNC_NOTIFY */
+#if (FREERTOS_STACK_MONITOR == 1)
+		StackMonitor::Entry stack_entry;
+#endif /* FREERTOS_STACK_MONITOR */
+#if (FREERTOS_DEFERRED_INIT == 1)
+		void (*init_handler)(void *) = nullptr;
+		void *init_params = nullptr;
+		const char *init_name = nullptr;
+		int init_priority = 0;
+		UBaseType_t init_core_mask = 0;
+#endif /* FREERTOS_DEFERRED_INIT */
+
+		void Create(void (*handler)(void *), void *params,
+		            const char *name, int priority,
+		            UBaseType_t core_mask) {
+#if (configUSE_CORE_AFFINITY == 1) && (configNUMBER_OF_CORES > 1)
+#if (configSUPPORT_STATIC_ALLOCATION == 1)
+			handle = xTaskCreateStaticAffinitySet(handler,
+			                           name,
+			                           stack_size,
+			                           params,
+			                           tskIDLE_PRIORITY + priority,
+			                           xStack,
+			                           &xTaskBuffer,
+			                           core_mask);
+			configASSERT(handle != nullptr);
+#else /* STATIC_ALLOCATION */
+			configASSERT(xTaskCreateAffinitySet(handler,
+			                         name,
+			                         stack_size,
+			                         params,
+			                         tskIDLE_PRIORITY + priority,
+			                         core_mask,
+			                         &handle) == pdPASS);
+#endif /* STATIC_ALLOCATION */
+#else /* configUSE_CORE_AFFINITY */
+			(void)core_mask;
+#if (configSUPPORT_STATIC_ALLOCATION == 1)
+			handle = xTaskCreateStatic(handler,
+			                           name,
+			                           stack_size,
+			                           params,
+			                           tskIDLE_PRIORITY + priority,
+			                           xStack,
+			                           &xTaskBuffer);
+			configASSERT(handle != nullptr);
+#else /* STATIC_ALLOCATION */
+			configASSERT(xTaskCreate(handler,
+			                         name,
+			                         stack_size,
+			                         params,
+			                         tskIDLE_PRIORITY + priority,
+			                         &handle) == pdPASS);
+#endif /* STATIC_ALLOCATION */
+#endif /* configUSE_CORE_AFFINITY */
+#if (FREERTOS_STACK_MONITOR == 1)
+			StackMonitor::Register(&stack_entry, handle, stack_size);
+#endif /* FREERTOS_STACK_MONITOR */
+		}
+
+		static void Trampoline(void *args) {
+			Task *t = static_cast<Task *>(args);
+			t->body();
+#if (FREERTOS_SYNC_NOTIFY == 1)
+			vTaskSuspendAll();
+			t->finished.store(true, std::memory_order_release);
+			TaskHandle_t joiner = t->joiner;
+			xTaskResumeAll();
+			if (joiner)
+				xTaskNotifyGiveIndexed(joiner,
+				                       FREERTOS_SYNC_NOTIFY_INDEX);
+#else /* FREERTOS_SYNC_NOTIFY */
+			t->finished.store(true, std::memory_order_release);
+#endif /* FREERTOS_SYNC_NOTIFY */
+#if (INCLUDE_vTaskSuspend == 1)
+			/* Deleted by destructor */
+			while (1)
+				vTaskSuspend(nullptr);
+#else /* INCLUDE_vTaskSuspend */
+#if (FREERTOS_STACK_MONITOR == 1)
+			StackMonitor::Unregister(&t->stack_entry);
+#endif /* FREERTOS_STACK_MONITOR */
+			t->handle = nullptr;
+			vTaskDelete(nullptr);
+#endif /* INCLUDE_vTaskSuspend */
+		}
+	public:
+		/**
+		 * @brief Affinity mask allowing the task to run on any core.
+		 */
+		static constexpr UBaseType_t AnyCore = (UBaseType_t)-1;
+
+		/**
+		 * @brief Create a new task and
+		 * add it to the list of tasks that are ready to run.
+		 *
+		 * The handler runs through the same trampoline as callables,
+		 * so Join() works and a handler that returns leaves the task
+		 * suspended instead of crashing.
+		 *
+		 * @param[in] handler	Pointer to the task entry function.
+		 * @param[in] params	[Optional] A value that is passed as the
+		 *			parameter to the created task.
+		 * @param[in] name	[Optional] Task name string.
+		 * @param[in] priority	[Optional] The priority at which the
+		 *			task will execute.
+		 * @param[in] core_mask	[Optional] Bit mask of cores the task
+		 *			may run on, ignored on single core
+		 *			builds.
+		 */
+		Task(void (*handler)(void *),
+			void *params = nullptr,
+			const char *name = nullptr,
+			int priority = tskIDLE_PRIORITY + 1,
+			UBaseType_t core_mask = AnyCore) {
+			body.Emplace([handler, params] { handler(params); });
+			Create(Trampoline, this, name, priority, core_mask);
+		}
+
+#if (FREERTOS_DEFERRED_INIT == 1)
+		/**
+		 * @brief Constant initialize without creating the task,
+		 * parameters as for the regular constructor.
+		 */
+		constexpr Task(DeferredInit,
+			void (*handler)(void *),
+			void *params = nullptr,
+			const char *name = nullptr,
+			int priority = tskIDLE_PRIORITY + 1,
+			UBaseType_t core_mask = AnyCore)
+			:
+#if (configSUPPORT_STATIC_ALLOCATION == 1)
+			  xStack(), xTaskBuffer(),
+#endif /* STATIC_ALLOCATION */
+			  init_handler(handler), init_params(params),
+			  init_name(name), init_priority(priority),
+			  init_core_mask(core_mask) {}
+
+		/**
+		 * @brief Create the task of a deferred object.
+		 */
+		void Init() {
+			configASSERT(handle == nullptr);
+			body.Emplace([handler = init_handler, params = init_params] {
+				handler(params);
+			});
+			Create(Trampoline, this, init_name, init_priority,
+			       init_core_mask);
+		}
+#endif /* FREERTOS_DEFERRED_INIT */
+
+		/**
+		 * @brief Create a new task running any callable, e.g. a lambda
+		 * with captures. The callable is stored inside the task
+		 * object, no memory is allocated.
+		 *
+		 * The task may return from the callable, it is then suspended
+		 * until the object is destroyed.
+		 *
+		 * @param[in] fn	Callable taking no arguments.
+		 * @param[in] name	[Optional] Task name string.
+		 * @param[in] priority	[Optional] The priority at which the
+		 *			task will execute.
+		 * @param[in] core_mask	[Optional] Bit mask of allowed cores.
+		 */
+		template <class F, class = typename std::enable_if<
+			!std::is_convertible<F, void (*)(void *)>::value>::type,
+			class = decltype(std::declval<F &>()())>
+		explicit Task(F &&fn,
+			const char *name = nullptr,
+			int priority = tskIDLE_PRIORITY + 1,
+			UBaseType_t core_mask = AnyCore) {
+			body.Emplace(std::forward<F>(fn));
+			Create(Trampoline, this, name, priority, core_mask);
+		}
+
+		/**
+		 * @brief Create a new task running a callable that takes
+		 * the task's StopToken.
+		 *
+		 * @param[in] fn	Callable taking StopToken.
+		 * @param[in] name	[Optional] Task name string.
+		 * @param[in] priority	[Optional] The priority at which the
+		 *			task will execute.
+		 * @param[in] core_mask	[Optional] Bit mask of allowed cores.
+		 */
+		template <class F, class = typename std::enable_if<
+			!std::is_convertible<F, void (*)(void *)>::value>::type,
+			class = decltype(std::declval<F &>()(StopToken())),
+			class = void>
+		explicit Task(F &&fn,
+			const char *name = nullptr,
+			int priority = tskIDLE_PRIORITY + 1,
+			UBaseType_t core_mask = AnyCore) {
+			body.Emplace([this, f = std::forward<F>(fn)]() mutable {
+				f(stop_source.GetToken());
+			});
+			Create(Trampoline, this, name, priority, core_mask);
+		}
+
+		/**
+		 * @brief Create a new task running a member function.
+		 *
+		 * @param[in] object	Object to call the method on.
+		 * @param[in] method	Method taking no arguments.
+		 * @param[in] name	[Optional] Task name string.
+		 * @param[in] priority	[Optional] The priority at which the
+		 *			task will execute.
+		 * @param[in] core_mask	[Optional] Bit mask of allowed cores.
+		 */
+		template <class C>
+		Task(C *object, void (C::*method)(),
+			const char *name = nullptr,
+			int priority = tskIDLE_PRIORITY + 1,
+			UBaseType_t core_mask = AnyCore)
+			: Task([object, method] { (object->*method)(); },
+			       name, priority, core_mask) {}
+
+		~Task() { Delete(); }
+
+#if (INCLUDE_vTaskDelete == 1)
+		/**
+		 * @brief Delete current task.
+		 */
+		void Delete() {
+#if (FREERTOS_STACK_MONITOR == 1)
+			if (handle)
+				StackMonitor::Unregister(&stack_entry);
+#endif /* FREERTOS_STACK_MONITOR */
+			if (handle) {
+				Watchdog::Forget(handle);
+#if (FREERTOS_BLOCKING_TRACE == 1)
+				BlockingTrace::Forget(handle);
+#endif /* FREERTOS_BLOCKING_TRACE */
+				vTaskDelete(handle);
+			}
+			handle = nullptr;
+		}
+
+		static void SelfDelete() {
+			Watchdog::Forget(xTaskGetCurrentTaskHandle());
+#if (FREERTOS_BLOCKING_TRACE == 1)
+			BlockingTrace::Forget(nullptr);
+#endif /* FREERTOS_BLOCKING_TRACE */
+			vTaskDelete(nullptr);
+		}
+#endif /* INCLUDE_vTaskDelete */
+
+#if (INCLUDE_vTaskSuspend == 1)
+		/**
+		 * @brief Put current task into idle state.
+		 */
+		void Suspend() {
+			vTaskSuspend(handle);
+		}
+#endif /* INCLUDE_vTaskSuspend */
+
+#if (INCLUDE_vTaskSuspend == 1)
+		/**
+		 * @brief Wake up current task.
+		 */
+		void Resume() {
+			vTaskResume(handle);
+		}
+#endif /* INCLUDE_vTaskSuspend */
+
+#if (INCLUDE_eTaskGetState == 1)
+		/**
+		 * @brief Get current task state.
+		 */
+		enum TaskState { Ready, Running, Blocked, Suspended, Deleted };
+		FREERTOS_NODISCARD
+		TaskState GetState() {
+			eTaskState state = eTaskGetState(handle);
+			return (TaskState)state;
+		}
+#endif /* INCLUDE_eTaskGetState */
+
+#if (configUSE_CORE_AFFINITY == 1) && (configNUMBER_OF_CORES > 1)
+		/**
+		 * @brief Restrict the task to a set of cores.
+		 *
+		 * @param[in] core_mask	Bit mask of allowed cores,
+		 *			Task::AnyCore to lift the restriction.
+		 */
+		void SetAffinity(UBaseType_t core_mask) {
+			vTaskCoreAffinitySet(handle, core_mask);
+		}
+
+		/**
+		 * @brief Get the set of cores the task may run on.
+		 *
+		 * @return Bit mask of allowed cores.
+		 */
+		FREERTOS_NODISCARD
+		UBaseType_t GetAffinity() const {
+			return vTaskCoreAffinityGet(handle);
+		}
+
+		/**
+		 * @brief Get the core the calling task is running on.
+		 *
+		 * @return Core number.
+		 */
+		FREERTOS_NODISCARD
+		static UBaseType_t CurrentCore() {
+			UBaseType_t core;
+			taskENTER_CRITICAL();
+			core = portGET_CORE_ID();
+			taskEXIT_CRITICAL();
+			return core;
+		}
+
+		/**
+		 * @brief Restrict the calling task to the core it is
+		 * running on right now.
+		 *
+		 * @return Core number the task is pinned to.
+		 */
+		static UBaseType_t PinToCurrentCore() {
+			UBaseType_t core = CurrentCore();
+			vTaskCoreAffinitySet(nullptr, (UBaseType_t)1 << core);
+			return core;
+		}
+#endif /* configUSE_CORE_AFFINITY */
+
+#if (configUSE_TASK_PREEMPTION_DISABLE == 1)
+		/**
+		 * @brief Prevent the task from being preempted by other
+		 * tasks. Interrupts are still served.
+		 */
+		void DisablePreemption() {
+			vTaskPreemptionDisable(handle);
+		}
+
+		/**
+		 * @brief Allow the task to be preempted again.
+		 */
+		void EnablePreemption() {
+			vTaskPreemptionEnable(handle);
+		}
+
+		/**
+		 * Scope in which the calling task is not preempted by other
+		 * tasks. Unlike a critical section, interrupts stay enabled and
+		 * other cores keep scheduling. Scopes do not nest.
+		 */
+		class NoPreemption
+		{
+		public:
+			NoPreemption() {
+				vTaskPreemptionDisable(nullptr);
+			}
+
+			~NoPreemption() {
+				vTaskPreemptionEnable(nullptr);
+			}
+
+			/**
+			 * @brief Prevent class to be copied.
+			 */
+			NoPreemption(const NoPreemption &) = delete;
+		};
+#endif /* configUSE_TASK_PREEMPTION_DISABLE */
+
+		/**
+		 * @brief Suspends the scheduler.
+		 *
+		 * Suspending the scheduler prevents a context switch from
+		 * occurring but leaves interrupts enabled. If an interrupt
+		 * requests a context switch while the scheduler is suspended,
+		 * then the request is held pending and is performed only when
+		 * the scheduler is resumed (un-suspended).
+		 */
+		static inline void SuspendAll() {
+			vTaskSuspendAll();
+		}
+
+		/**
+		 * @brief Resumes the scheduler after it was suspended using
+		 * a call to vTaskSuspendAll().
+		 */
+		static inline void ResumeAll() {
+			xTaskResumeAll();
+		}
+
+		/**
+		 * @brief taskYIELD() is used to request a context switch to
+		 * another task. However, if there are no other tasks at a
+		 * higher or equal priority to the task that calls taskYIELD()
+		 * then the RTOS scheduler will simply select the task that
+		 * called taskYIELD() to run again.
+		 */
+		static inline void DoYield() {
+			taskYIELD();
+		}
+
+		/**
+		 * @brief Critical sections are entered by calling
+		 * taskENTER_CRITICAL(), and subsequently exited by calling
+		 * taskEXIT_CRITICAL().
+		 */
+		static inline void EnterCritical() {
+			taskENTER_CRITICAL();
+		}
+
+		/**
+		 * @brief Critical sections are entered by calling
+		 * taskENTER_CRITICAL(), and subsequently exited by calling
+		 * taskEXIT_CRITICAL().
+		 *
+		 * The taskENTER_CRITICAL() and taskEXIT_CRITICAL() macros
+		 * provide a basic critical section implementation that works
+		 * by simply disabling interrupts, either globally, or up to a
+		 * specific interrupt priority level. See the vTaskSuspendAll()
+		 * RTOS API function for information on creating a critical
+		 * section without disabling interrupts.
+		 */
+		static inline void ExitCritical() {
+			taskEXIT_CRITICAL();
+		}
+
+		/**
+		 * @brief Prevent class to be copied.
+		 */
+		Task(const Task &) = delete;
+
+#if (INCLUDE_uxTaskGetStackHighWaterMark == 1)
+		/**
+		 * @brief Get the minimum amount of free stack since the task
+		 * was started.
+		 *
+		 * @return Free stack in words, the closer to zero the closer
+		 * the task came to overflow.
+		 */
+		FREERTOS_NODISCARD
+		size_t StackHighWaterMark() const {
+			return uxTaskGetStackHighWaterMark(handle);
+		}
+#endif /* INCLUDE_uxTaskGetStackHighWaterMark */
+
+		/**
+		 * @brief Get stack size of the task.
+		 *
+		 * @return Stack size in words.
+		 */
+		FREERTOS_NODISCARD
+		static constexpr size_t StackSize() {
+			return stack_size;
+		}
+
+		/**
+		 * @brief Ask the task to finish. Stop-aware blocking calls
+		 * made with its token return early.
+		 */
+		void RequestStop() {
+			stop_source.RequestStop();
+		}
+
+		/**
+		 * @brief Get token observing stop requests of this task.
+		 */
+		FREERTOS_NODISCARD
+		StopToken GetStopToken() const {
+			return stop_source.GetToken();
+		}
+
+#if (FREERTOS_SYNC_NOTIFY == 1)
+		/**
+		 * @brief Wait for the task function to return.
+		 *
+		 * Only one task may join at a time. Uses notification index
+		 * FREERTOS_SYNC_NOTIFY_INDEX of the caller.
+		 *
+		 * @param[in] wait_ms	[Optional] Time to wait in [ms].
+		 *
+		 * @return true if the task finished, false on timeout.
+		 */
+		bool Join(size_t wait_ms = WAIT_MAX) {
+			TimeOut_t timeout;
+			TickType_t ticks = pdMS_TO_TICKS(wait_ms);
+			bool done;
+
+			configASSERT(handle != xTaskGetCurrentTaskHandle());
+			vTaskSuspendAll();
+			done = finished.load(std::memory_order_acquire);
+			if (!done)
+				joiner = xTaskGetCurrentTaskHandle();
+			xTaskResumeAll();
+
+			vTaskSetTimeOutState(&timeout);
+			while (!done) {
+				ulTaskNotifyTakeIndexed(FREERTOS_SYNC_NOTIFY_INDEX,
+				                        pdTRUE, ticks);
+				done = finished.load(std::memory_order_acquire);
+				if (!done && xTaskCheckForTimeOut(&timeout,
+				                                  &ticks) == pdTRUE)
+					break;
+			}
+
+			vTaskSuspendAll();
+			joiner = nullptr;
+			xTaskResumeAll();
+			return done;
+		}
+#endif /* FREERTOS_SYNC_NOTIFY */
+
+		/**
+		 * @brief Check if the task function returned.
+		 */
+		FREERTOS_NODISCARD
+		bool Finished() const {
+			return finished.load(std::memory_order_acquire);
+		}
+
+		/**
+		 * @brief Get kernel handle of the task.
+		 */
+		FREERTOS_NODISCARD
+		TaskHandle_t GetHandle() const {
+			return handle;
+		}
+
+#if (configUSE_TASK_NOTIFICATIONS == 1)
+		/**
+		 * @brief Send notify to task.
+		 *
+		 * @param[in] index		[Optional] he index within the
+		 *				target task's array of
+		 *				notification values to which the
+		 *				notification is to be sent.
+		 */
+		void NotifyGive(int index = -1) {
+			if (index >= 0) {
+				configASSERT(xTaskNotifyGiveIndexed(handle,
+					index) == pdPASS);
+			} else {
+				configASSERT(xTaskNotifyGive(handle) == pdPASS);
+			}
+		}
+
+		/**
+		 * @brief Send notify to task from ISR.
+		 *
+		 * @param[in] index		[Optional] he index within the
+		 *				target task's array of
+		 *				notification values to which the
+		 *				notification is to be sent.
+		 * @param[out] woken		[Optional] Set to pdTRUE if a
+		 *				context switch should be
+		 *				requested before the interrupt
+		 *				exits.
+		 */
+		void NotifyGiveFromISR(int index = -1,
+		                       BaseType_t *woken = nullptr) {
+			if (index >= 0) {
+				vTaskNotifyGiveIndexedFromISR(handle, index,
+				                              woken);
+			} else {
+				vTaskNotifyGiveFromISR(handle, woken);
+			}
+		}
+
+		/**
+		 * @brief Update notification value of the task.
+		 *
+		 * @param[in] value		Value used by the action.
+		 * @param[in] action		eSetBits, eIncrement,
+		 *				eSetValueWithOverwrite,
+		 *				eSetValueWithoutOverwrite or
+		 *				eNoAction.
+		 * @param[in] index		[Optional] Index within the
+		 *				task's array of notification
+		 *				values.
+		 *
+		 * @return false only if eSetValueWithoutOverwrite found an
+		 * unread value.
+		 */
+		bool Notify(uint32_t value, eNotifyAction action,
+		            int index = -1) {
+			if (index >= 0)
+				return xTaskNotifyIndexed(handle, index, value,
+				                          action) == pdPASS;
+			return xTaskNotify(handle, value, action) == pdPASS;
+		}
+
+		/**
+		 * @brief Update notification value of the task from ISR.
+		 *
+		 * @param[in] value		Value used by the action.
+		 * @param[in] action		See Notify().
+		 * @param[out] woken		[Optional] Set to pdTRUE if a
+		 *				context switch should be
+		 *				requested before the interrupt
+		 *				exits.
+		 * @param[in] index		[Optional] Index within the
+		 *				task's array of notification
+		 *				values.
+		 *
+		 * @return false only if eSetValueWithoutOverwrite found an
+		 * unread value.
+		 */
+		bool NotifyFromISR(uint32_t value, eNotifyAction action,
+		                   BaseType_t *woken = nullptr,
+		                   int index = -1) {
+			if (index >= 0)
+				return xTaskNotifyIndexedFromISR(handle, index,
+					value, action, woken) == pdPASS;
+			return xTaskNotifyFromISR(handle, value, action,
+			                          woken) == pdPASS;
+		}
+
+		/**
+		 * @brief Wait for a notification of the calling task.
+		 *
+		 * @param[out] value		[Optional] Notification value
+		 *				before clear_on_exit is applied.
+		 * @param[in] wait_ms		[Optional] Time to wait in [ms].
+		 * @param[in] clear_on_entry	[Optional] Bits cleared before
+		 *				waiting.
+		 * @param[in] clear_on_exit	[Optional] Bits cleared after
+		 *				a notification is received.
+		 * @param[in] index		[Optional] Index to wait for.
+		 *
+		 * @return true if notified, false on timeout.
+		 */
+		static bool NotifyWait(uint32_t *value = nullptr,
+		                       size_t wait_ms = WAIT_MAX,
+		                       uint32_t clear_on_entry = 0,
+		                       uint32_t clear_on_exit = UINT32_MAX,
+		                       int index = -1) {
+			if (index >= 0)
+				return xTaskNotifyWaitIndexed(index,
+					clear_on_entry, clear_on_exit, value,
+					pdMS_TO_TICKS(wait_ms)) == pdPASS;
+			return xTaskNotifyWait(clear_on_entry, clear_on_exit,
+				value, pdMS_TO_TICKS(wait_ms)) == pdPASS;
+		}
+
+		/**
+		 * @brief Wait for notify.
+		 *
+		 * @param wait_ms		Time to wait in [ms].
+		 * @param reset			[Optional] Reset notify after.
+		 * @param index			[Optional] Index to wait for.
+		 *
+		 * @return The value of the task's notification value before it
+		 * is decremented or cleared.
+		 */
+		uint32_t NotifyTake(size_t wait_ms,
+		                    bool reset = true,
+		                    int index = -1) {
+			if (index >= 0) {
+				return ulTaskNotifyTakeIndexed(index, reset,
+					pdMS_TO_TICKS(wait_ms));
+			} else {
+				return ulTaskNotifyTake(reset,
+					pdMS_TO_TICKS(wait_ms));
+			}
+		}
+#endif /* configUSE_TASK_NOTIFICATIONS */
+
+		/**
+		 * Critical section control can be used from interrupt context.
+		 */
+		class Isr
+		{
+		protected:
+			static inline UBaseType_t uxSavedInterruptStatus;
+		public:
+			/**
+			 * @brief See Task::EnterCritical()
+			 */
+			static void EnterCritical() {
+				uxSavedInterruptStatus =
+						taskENTER_CRITICAL_FROM_ISR();
+			}
+
+			/**
+			 * @brief See Task::ExitCritical()
+			 */
+			static void ExitCritical() {
+				taskEXIT_CRITICAL_FROM_ISR(uxSavedInterruptStatus);
+			}
+		};
+
+#if (INCLUDE_vTaskDelete == 1)
+		/**
+		 * Class to execute code asynchronously.
+		 *
+		 * A task is created for every job, use AsyncExecutor for
+		 * frequent jobs.
+		 */
+		class DoAsync
+		{
+		protected:
+			void (*async_job)();
+			BinarySemaphore done;
+#if (configSUPPORT_STATIC_ALLOCATION == 1)
+			StackType_t xStack[stack_size];
+			StaticTask_t xTaskBuffer;
+#endif /* STATIC_ALLOCATION */
+			static void handler(void *args) {
+				DoAsync *c = static_cast<DoAsync *>(args);
+				c->async_job();
+				c->done.Give();
+				Task::SelfDelete();
+			}
+		public:
+			/**
+			 * @brief Calls pointer to function from new task.
+			 * After job is done, task is self deleted.
+			 *
+			 * @param job		Callback function to call
+			 *			asynchronously.
+			 * @param priority	[Optional] Priority
+			 */
+			DoAsync(void (*job)(),
+			        size_t priority = 1) {
+				async_job = job;
+#if (configSUPPORT_STATIC_ALLOCATION == 1)
+				configASSERT(xTaskCreateStatic(handler,
+			                           nullptr,
+			                           stack_size,
+			                           this,
+			                           tskIDLE_PRIORITY + priority,
+			                           xStack,
+			                           &xTaskBuffer) != nullptr);
+#else /* STATIC_ALLOCATION */
+				configASSERT(xTaskCreate(handler,
+			                         nullptr,
+			                         stack_size,
+			                         this,
+			                         tskIDLE_PRIORITY + priority,
+			                         nullptr) == pdPASS);
+#endif /* STATIC_ALLOCATION */
+			}
+			~DoAsync() {
+				done.Take(WAIT_MAX);
+			}
+		};
+
+#if (FREERTOS_SYNC_NOTIFY == 1)
+		/**
+		 * Class to execute code asynchronously and get its result.
+		 *
+		 * @tparam T		Type returned by the job, may be void.
+		 */
+		template <class T>
+		class Async
+		{
+		protected:
+			InlineFunction<T(), functor_size> async_job;
+			Promise<T> promise;
+			TaskHandle_t async_handle = nullptr;
+#if (configSUPPORT_STATIC_ALLOCATION == 1)
+			StackType_t xStack[stack_size];
+			StaticTask_t xTaskBuffer;
+#endif /* STATIC_ALLOCATION */
+			static void handler(void *args) {
+				Async *c = static_cast<Async *>(args);
+				if constexpr (std::is_void<T>::value) {
+					c->async_job();
+					c->promise.SetValue();
+				} else {
+					c->promise.SetValue(c->async_job());
+				}
+#if (INCLUDE_vTaskSuspend == 1)
+				/* Deleted by destructor */
+				while (1)
+					vTaskSuspend(nullptr);
+#else /* INCLUDE_vTaskSuspend */
+				Task::SelfDelete();
+#endif /* INCLUDE_vTaskSuspend */
+			}
+		public:
+			/**
+			 * @brief Calls a callable from new task.
+			 *
+			 * @param job		Callable to call asynchronously,
+			 *			its return value is delivered
+			 *			through the future. Captures
+			 *			must fit into functor_size
+			 *			bytes.
+			 * @param priority	[Optional] Priority
+			 */
+			template <class F,
+				class = decltype(std::declval<F &>()())>
+			Async(F &&job, size_t priority = 1)
+				: async_job(std::forward<F>(job)) {
+#if (configSUPPORT_STATIC_ALLOCATION == 1)
+				async_handle = xTaskCreateStatic(handler,
+			                           nullptr,
+			                           stack_size,
+			                           this,
+			                           tskIDLE_PRIORITY + priority,
+			                           xStack,
+			                           &xTaskBuffer);
+				configASSERT(async_handle != nullptr);
+#else /* STATIC_ALLOCATION */
+				configASSERT(xTaskCreate(handler,
+			                         nullptr,
+			                         stack_size,
+			                         this,
+			                         tskIDLE_PRIORITY + priority,
+			                         &async_handle) == pdPASS);
+#endif /* STATIC_ALLOCATION */
+			}
+
+			/**
+			 * @brief Prevent class to be copied.
+			 */
+			Async(const Async &) = delete;
+
+			/**
+			 * @brief Waits for the job to complete.
+			 */
+			~Async() {
+				GetFuture().Get(WAIT_MAX);
+#if (INCLUDE_vTaskSuspend == 1)
+				vTaskDelete(async_handle);
+#endif /* INCLUDE_vTaskSuspend */
+			}
+
+			/**
+			 * @brief Get future to access the result.
+			 */
+			Future<T> GetFuture() {
+				return promise.GetFuture();
+			}
+		};
+#endif /* FREERTOS_SYNC_NOTIFY */
+#endif /* INCLUDE_vTaskDelete */
+	};
+
+#if (configUSE_TASK_NOTIFICATIONS == 1)
+	/**
+	 * @brief Binary semaphore implemented with a task notification.
+	 *
+	 * Faster and smaller than BinarySemaphore, but only the task it is
+	 * bound to can take it. Giving fails until the owner is known, so bind
+	 * it before an interrupt may give.
+	 */
+	class NotifySemaphore
+	{
+	protected:
+		std::atomic<TaskHandle_t> owner;
+		UBaseType_t index;
+
+		TaskHandle_t Owner() const {
+			return owner.load(std::memory_order_acquire);
+		}
+
+		void Bind() {
+			TaskHandle_t self = xTaskGetCurrentTaskHandle();
+			TaskHandle_t expected = nullptr;
+
+			if (!owner.compare_exchange_strong(expected, self,
+			                                   std::memory_order_acq_rel))
+				configASSERT(expected == self);
+		}
+	public:
+		/**
+		 * @brief Create a semaphore bound to a task.
+		 *
+		 * @param[in] task	[Optional] Task allowed to take the
+		 *			semaphore. If not set, the first task
+		 *			calling Take() becomes the owner.
+		 * @param[in] index	[Optional] Index within the task's
+		 *			array of notification values.
+		 */
+		explicit NotifySemaphore(TaskHandle_t task = nullptr,
+		                         UBaseType_t index = 0)
+			: owner(task), index(index) {
+			configASSERT(index < configTASK_NOTIFICATION_ARRAY_ENTRIES);
+		}
+
+		/**
+		 * @brief Prevent class to be copied.
+		 */
+		NotifySemaphore(const NotifySemaphore &) = delete;
+
+		/**
+		 * @brief Bind semaphore to a task.
+		 *
+		 * @param[in] task	Task allowed to take the semaphore.
+		 */
+		void SetOwner(TaskHandle_t task) {
+			owner.store(task, std::memory_order_release);
+		}
+
+		/**
+		 * @brief Give semaphore.
+		 *
+		 * @return true if given, false if already given before or
+		 * no owner is bound yet.
+		 */
+		bool Give() {
+			TaskHandle_t task = Owner();
+
+			configASSERT(task != nullptr);
+			if (!task)
+				return false;
+			return xTaskNotifyIndexed(task, index, 1,
+				eSetValueWithoutOverwrite) == pdPASS;
+		}
+
+		/**
+		 * @brief Give semaphore from ISR.
+		 *
+		 * @param[out] woken	[Optional] Set to pdTRUE if a context
+		 *			switch should be requested before the
+		 *			interrupt exits.
+		 *
+		 * @return true if given, false if already given before or
+		 * no owner is bound yet.
+		 */
+		bool GiveFromISR(BaseType_t *woken = nullptr) {
+			TaskHandle_t task = Owner();
+
+			configASSERT(task != nullptr);
+			if (!task)
+				return false;
+			return xTaskNotifyIndexedFromISR(task, index, 1,
+				eSetValueWithoutOverwrite, woken) == pdPASS;
+		}
+
+		/**
+		 * @brief Wait for semaphore to be given. Must be called by
+		 * the owner task.
+		 *
+		 * @param[in] wait_ms	[Optional] Time to wait in [ms].
+		 *
+		 * @return true if semaphore obtained successfully, false
+		 * on timeout.
+		 */
+		bool Take(size_t wait_ms = WAIT_MAX) {
+			Bind();
+			return ulTaskNotifyTakeIndexed(index, pdTRUE,
+				pdMS_TO_TICKS(wait_ms)) != 0;
+		}
+	};
+
+	/**
+	 * @brief Counting semaphore implemented with a task notification.
+	 */
+	class NotifyCounter : public NotifySemaphore
+	{
+	public:
+		using NotifySemaphore::NotifySemaphore;
+
+		/**
+		 * @brief Increment the counter.
+		 *
+		 * @return true, false if no owner is bound yet.
+		 */
+		bool Give() {
+			TaskHandle_t task = Owner();
+
+			configASSERT(task != nullptr);
+			if (!task)
+				return false;
+			return xTaskNotifyGiveIndexed(task, index) == pdPASS;
+		}
+
+		/**
+		 * @brief Increment the counter from ISR.
+		 *
+		 * @param[out] woken	[Optional] Set to pdTRUE if a context
+		 *			switch should be requested before the
+		 *			interrupt exits.
+		 *
+		 * @return true, false if no owner is bound yet.
+		 */
+		bool GiveFromISR(BaseType_t *woken = nullptr) {
+			TaskHandle_t task = Owner();
+
+			configASSERT(task != nullptr);
+			if (!task)
+				return false;
+			vTaskNotifyGiveIndexedFromISR(task, index, woken);
+			return true;
+		}
+
+		/**
+		 * @brief Wait for counter to be non zero and decrement it.
+		 * Must be called by the owner task.
+		 *
+		 * @param[in] wait_ms	[Optional] Time to wait in [ms].
+		 *
+		 * @return true if counter decremented, false on timeout.
+		 */
+		bool Take(size_t wait_ms = WAIT_MAX) {
+			Bind();
+			return ulTaskNotifyTakeIndexed(index, pdFALSE,
+				pdMS_TO_TICKS(wait_ms)) != 0;
+		}
+
+		/**
+		 * @brief Wait for counter to be non zero and reset it.
+		 * Must be called by the owner task.
+		 *
+		 * @param[in] wait_ms	[Optional] Time to wait in [ms].
+		 *
+		 * @return Counter value before reset, 0 on timeout.
+		 */
+		uint32_t TakeAll(size_t wait_ms = WAIT_MAX) {
+			Bind();
+			return ulTaskNotifyTakeIndexed(index, pdTRUE,
+				pdMS_TO_TICKS(wait_ms));
+		}
+
+		/**
+		 * @brief Read current count value.
+		 *
+		 * @return Count value.
+		 */
+		FREERTOS_NODISCARD
+		uint32_t GetCount() {
+			TaskHandle_t task = Owner();
+
+			configASSERT(task != nullptr);
+			if (!task)
+				return 0;
+			return ulTaskNotifyValueClearIndexed(task, index, 0);
+		}
+	};
+
+	/**
+	 * @brief Single value mailbox implemented with a task notification.
+	 *
+	 * Passes one word (small enum, index, pointer on 32 bit targets) to the
+	 * task it is bound to, without any queue.
+	 *
+	 * @tparam T	Trivially copyable type of at most 32 bits.
+	 */
+	template <class T>
+	class NotifyMailbox : protected NotifySemaphore
+	{
+		static_assert(sizeof(T) <= sizeof(uint32_t),
+			"Mailbox payload must fit into 32 bits");
+		static_assert(std::is_trivially_copyable<T>::value,
+			"Mailbox payload must be trivially copyable");
+
+		static uint32_t Encode(const T &value) {
+			uint32_t word = 0;
+			memcpy(&word, &value, sizeof(T));
+			return word;
+		}
+
+		static T Decode(uint32_t word) {
+			T value;
+			memcpy(&value, &word, sizeof(T));
+			return value;
+		}
+	public:
+		using NotifySemaphore::NotifySemaphore;
+		using NotifySemaphore::SetOwner;
+
+		/**
+		 * @brief Post a value unless the previous one is unread.
+		 *
+		 * @param[in] value	Value to send.
+		 *
+		 * @return true if posted, false if mailbox is full or no
+		 * owner is bound yet.
+		 */
+		bool Post(const T &value) {
+			TaskHandle_t task = Owner();
+
+			configASSERT(task != nullptr);
+			if (!task)
+				return false;
+			return xTaskNotifyIndexed(task, index, Encode(value),
+				eSetValueWithoutOverwrite) == pdPASS;
+		}
+
+		/**
+		 * @brief Post a value from ISR unless the previous one is
+		 * unread.
+		 *
+		 * @param[in] value	Value to send.
+		 * @param[out] woken	[Optional] Set to pdTRUE if a context
+		 *			switch should be requested before the
+		 *			interrupt exits.
+		 *
+		 * @return true if posted, false if mailbox is full or no
+		 * owner is bound yet.
+		 */
+		bool PostFromISR(const T &value, BaseType_t *woken = nullptr) {
+			TaskHandle_t task = Owner();
+
+			configASSERT(task != nullptr);
+			if (!task)
+				return false;
+			return xTaskNotifyIndexedFromISR(task, index,
+				Encode(value), eSetValueWithoutOverwrite,
+				woken) == pdPASS;
+		}
+
+		/**
+		 * @brief Post a value, an unread one is replaced.
+		 *
+		 * @param[in] value	Value to send.
+		 *
+		 * @return true if posted, false if no owner is bound yet.
+		 */
+		bool Overwrite(const T &value) {
+			TaskHandle_t task = Owner();
+
+			configASSERT(task != nullptr);
+			if (!task)
+				return false;
+			xTaskNotifyIndexed(task, index, Encode(value),
+				eSetValueWithOverwrite);
+			return true;
+		}
+
+		/**
+		 * @brief Post a value from ISR, an unread one is replaced.
+		 *
+		 * @param[in] value	Value to send.
+		 * @param[out] woken	[Optional] Set to pdTRUE if a context
+		 *			switch should be requested before the
+		 *			interrupt exits.
+		 *
+		 * @return true if posted, false if no owner is bound yet.
+		 */
+		bool OverwriteFromISR(const T &value,
+		                      BaseType_t *woken = nullptr) {
+			TaskHandle_t task = Owner();
+
+			configASSERT(task != nullptr);
+			if (!task)
+				return false;
+			xTaskNotifyIndexedFromISR(task, index, Encode(value),
+				eSetValueWithOverwrite, woken);
+			return true;
+		}
+
+		/**
+		 * @brief Wait for a value. Must be called by the owner task.
+		 *
+		 * @param[out] value	Received value.
+		 * @param[in] wait_ms	[Optional] Time to wait in [ms].
+		 *
+		 * @return true if a value was received, false on timeout.
+		 */
+		bool Receive(T &value, size_t wait_ms = WAIT_MAX) {
+			uint32_t word;
+
+			Bind();
+			if (xTaskNotifyWaitIndexed(index, 0, 0, &word,
+			                           pdMS_TO_TICKS(wait_ms)) != pdPASS)
+				return false;
+			value = Decode(word);
+			return true;
+		}
+	};
+#endif /* configUSE_TASK_NOTIFICATIONS */
+
+#if (FREERTOS_SYNC_NOTIFY == 1)
+	/**
+	 * @brief List of tasks blocked on a synchronization primitive.
+	 *
+	 * Waiters live on the stack of the waiting task, so waking any amount
+	 * of tasks needs no allocation. Tasks are woken with notification
+	 * FREERTOS_SYNC_NOTIFY_INDEX, higher priority tasks first.
+	 */
+	class WaitList
+	{
+		static_assert(FREERTOS_SYNC_NOTIFY_INDEX > 0 &&
+			FREERTOS_SYNC_NOTIFY_INDEX <
+			configTASK_NOTIFICATION_ARRAY_ENTRIES,
+			"WaitList needs its own notification index, set "
+			"configTASK_NOTIFICATION_ARRAY_ENTRIES to 2 or more");
+	public:
+		/**
+		 * @brief Entry of a waiting task.
+		 */
+		struct Waiter
+		{
+			TaskHandle_t task = xTaskGetCurrentTaskHandle();
+#if (INCLUDE_uxTaskPriorityGet == 1)
+			UBaseType_t priority = uxTaskPriorityGet(nullptr);
+#else /* INCLUDE_uxTaskPriorityGet */
+			UBaseType_t priority = 0;
+#endif /* INCLUDE_uxTaskPriorityGet */
+			Waiter *next = nullptr;
+		};
+	protected:
+		Waiter *head = nullptr;
+
+		void Insert(Waiter &w) {
+			Waiter **p = &head;
+			while (*p && (*p)->priority >= w.priority)
+				p = &(*p)->next;
+			w.next = *p;
+			*p = &w;
+		}
+
+		bool Remove(Waiter &w) {
+			for (Waiter **p = &head; *p; p = &(*p)->next) {
+				if (*p == &w) {
+					*p = w.next;
+					return true;
+				}
+			}
+			return false;
+		}
+
+		bool Contains(const Waiter &w) const {
+			for (const Waiter *i = head; i; i = i->next)
+				if (i == &w)
+					return true;
+			return false;
+		}
+
+		static void Wake(Waiter *w) {
+			xTaskNotifyGiveIndexed(w->task,
+			                       FREERTOS_SYNC_NOTIFY_INDEX);
+		}
+	public:
+		WaitList() {}
+
+		/**
+		 * @brief Prevent class to be copied.
+		 */
+		WaitList(const WaitList &) = delete;
+
+		/**
+		 * @brief Add calling task to the list. Must be followed by
+		 * Block().
+		 *
+		 * @param[in] w		Waiter allocated on caller's stack.
+		 */
+		void Add(Waiter &w) {
+			vTaskSuspendAll();
+			Insert(w);
+			xTaskResumeAll();
+		}
+
+		/**
+		 * @brief Block until woken or timeout. On return the waiter
+		 * is no longer in the list.
+		 *
+		 * A wake-up sent between Add() and Block() is not lost.
+		 *
+		 * @param[in] w		Waiter passed to Add().
+		 * @param[in] ticks	Time to wait in ticks.
+		 *
+		 * @return true if woken, false on timeout.
+		 */
+		bool Block(Waiter &w, TickType_t ticks) {
+			TimeOut_t timeout;
+
+			vTaskSetTimeOutState(&timeout);
+			for (;;) {
+				bool notified = ulTaskNotifyTakeIndexed(
+					FREERTOS_SYNC_NOTIFY_INDEX, pdTRUE,
+					ticks) != 0;
+
+				vTaskSuspendAll();
+				bool woken = !Contains(w);
+				bool expired = !woken && (!notified ||
+					xTaskCheckForTimeOut(&timeout, &ticks));
+				if (expired)
+					Remove(w);
+				xTaskResumeAll();
+
+				if (woken) {
+					/* Woken right after timeout */
+					if (!notified)
+						ulTaskNotifyTakeIndexed(
+						  FREERTOS_SYNC_NOTIFY_INDEX,
+						  pdTRUE, 0);
+					return true;
+				}
+				if (expired)
+					return false;
+			}
+		}
+
+		/**
+		 * @brief Wake the highest priority waiter.
+		 *
+		 * @return true if a task was woken.
+		 */
+		bool WakeOne() {
+			vTaskSuspendAll();
+			Waiter *w = head;
+			if (w) {
+				head = w->next;
+				Wake(w);
+			}
+			xTaskResumeAll();
+			return w != nullptr;
+		}
+
+		/**
+		 * @brief Wake all waiters.
+		 *
+		 * @return Amount of tasks woken.
+		 */
+		size_t WakeAll() {
+			size_t n = 0;
+
+			vTaskSuspendAll();
+			for (Waiter *w = head; w; w = w->next, n++)
+				Wake(w);
+			head = nullptr;
+			xTaskResumeAll();
+			return n;
+		}
+
+		/**
+		 * @brief Check if any task is waiting.
+		 */
+		FREERTOS_NODISCARD
+		bool Empty() const {
+			return head == nullptr;
+		}
+	};
+
+	/**
+	 * @brief Condition variable to be used together with Mutex.
+	 *
+	 * Based on task notifications, see WaitList.
+	 */
+	class ConditionVariable
+	{
+	protected:
+		WaitList waiters;
+
+		bool WaitTicks(Mutex &lock, TickType_t ticks) {
+			WaitList::Waiter w;
+
+			waiters.Add(w);
+			lock.Unlock();
+			bool ret = waiters.Block(w, ticks);
+			lock.Lock();
+			return ret;
+		}
+	public:
+		ConditionVariable() {}
+
+		/**
+		 * @brief Prevent class to be copied.
+		 */
+		ConditionVariable(const ConditionVariable &) = delete;
+
+		/**
+		 * @brief Release the mutex, wait for notification and take
+		 * the mutex back.
+		 *
+		 * @param[in] lock	Mutex locked by calling task.
+		 * @param[in] wait_ms	[Optional] Time to wait in [ms].
+		 *
+		 * @return true if notified, false on timeout.
+		 */
+		bool Wait(Mutex &lock, size_t wait_ms = WAIT_MAX) {
+			return WaitTicks(lock, pdMS_TO_TICKS(wait_ms));
+		}
+
+		/**
+		 * @brief Wait until predicate becomes true.
+		 *
+		 * @param[in] lock	Mutex locked by calling task, the
+		 *			predicate is checked with mutex locked.
+		 * @param[in] pred	Condition to wait for.
+		 * @param[in] wait_ms	[Optional] Time to wait in [ms].
+		 *
+		 * @return Predicate value, false on timeout.
+		 */
+		template <class Predicate,
+		          class = decltype(std::declval<Predicate &>()())>
+		bool Wait(Mutex &lock, Predicate pred,
+		          size_t wait_ms = WAIT_MAX) {
+			TickType_t ticks = pdMS_TO_TICKS(wait_ms);
+			TimeOut_t timeout;
+
+			vTaskSetTimeOutState(&timeout);
+			while (!pred()) {
+				if (xTaskCheckForTimeOut(&timeout, &ticks))
+					return pred();
+				WaitTicks(lock, ticks);
+			}
+			return true;
+		}
+
+		/**
+		 * @brief Wake the highest priority waiting task.
+		 */
+		void NotifyOne() {
+			waiters.WakeOne();
+		}
+
+		/**
+		 * @brief Wake all waiting tasks.
+		 */
+		void NotifyAll() {
+			waiters.WakeAll();
+		}
+	};
+
+	/**
+	 * @brief Single use countdown, tasks wait until it reaches zero.
+	 */
+	class Latch
+	{
+	protected:
+		size_t count;
+		WaitList waiters;
+	public:
+		/**
+		 * @brief Create a latch.
+		 *
+		 * @param[in] count	Amount of CountDown() calls to release
+		 *			waiting tasks.
+		 */
+		explicit Latch(size_t count) : count(count) {}
+
+		/**
+		 * @brief Prevent class to be copied.
+		 */
+		Latch(const Latch &) = delete;
+
+		/**
+		 * @brief Decrement the counter, release all waiting tasks
+		 * when it reaches zero.
+		 *
+		 * @param[in] n		[Optional] Value to decrement by.
+		 */
+		void CountDown(size_t n = 1) {
+			vTaskSuspendAll();
+			if (count) {
+				count = n < count ? count - n : 0;
+				if (!count)
+					waiters.WakeAll();
+			}
+			xTaskResumeAll();
+		}
+
+		/**
+		 * @brief Check if counter has reached zero.
+		 */
+		FREERTOS_NODISCARD
+		bool TryWait() const {
+			return count == 0;
+		}
+
+		/**
+		 * @brief Wait for the counter to reach zero.
+		 *
+		 * @param[in] wait_ms	[Optional] Time to wait in [ms].
+		 *
+		 * @return true if released, false on timeout.
+		 */
+		bool Wait(size_t wait_ms = WAIT_MAX) {
+			return WaitTicks(pdMS_TO_TICKS(wait_ms));
+		}
+
+		/**
+		 * @brief Wait for the counter to reach zero.
+		 *
+		 * @param[in] ticks	Time to wait in ticks.
+		 *
+		 * @return true if released, false on timeout.
+		 */
+		bool WaitTicks(TickType_t ticks) {
+			WaitList::Waiter w;
+
+			vTaskSuspendAll();
+			if (!count) {
+				xTaskResumeAll();
+				return true;
+			}
+			waiters.Add(w);
+			xTaskResumeAll();
+			return waiters.Block(w, ticks);
+		}
+
+		/**
+		 * @brief Decrement the counter and wait for it to reach zero.
+		 *
+		 * @param[in] wait_ms	[Optional] Time to wait in [ms].
+		 *
+		 * @return true if released, false on timeout.
+		 */
+		bool ArriveAndWait(size_t wait_ms = WAIT_MAX) {
+			CountDown();
+			return Wait(wait_ms);
+		}
+	};
+
+	/**
+	 * @brief Reusable barrier for a fixed group of tasks.
+	 *
+	 * Each phase completes when all participants arrive. The last one
+	 * runs the optional completion function and wakes the others,
+	 * one notification per participant.
+	 */
+	class Barrier
+	{
+	protected:
+		const size_t expected;
+		size_t arrived = 0;
+		size_t phase = 0;
+		void (*completion)();
+		WaitList waiters;
+
+		void Complete() {
+			if (completion)
+				completion();
+			vTaskSuspendAll();
+			arrived = 0;
+			phase++;
+			waiters.WakeAll();
+			xTaskResumeAll();
+		}
+	public:
+		/**
+		 * @brief Create a barrier.
+		 *
+		 * @param[in] count		Number of participating tasks.
+		 * @param[in] completion	[Optional] Function called by
+		 *				the last arriving task before
+		 *				others are released.
+		 */
+		explicit Barrier(size_t count, void (*completion)() = nullptr)
+			: expected(count), completion(completion) {
+			configASSERT(count != 0);
+		}
+
+		/**
+		 * @brief Prevent class to be copied.
+		 */
+		Barrier(const Barrier &) = delete;
+
+		/**
+		 * @brief Arrive at the barrier and wait for other
+		 * participants.
+		 *
+		 * A participant that times out withdraws its arrival, unless
+		 * its phase is already completing or completed.
+		 *
+		 * @param[in] wait_ms	[Optional] Time to wait in [ms].
+		 *
+		 * @return true if phase completed, false on timeout.
+		 */
+		bool ArriveAndWait(size_t wait_ms = WAIT_MAX) {
+			WaitList::Waiter w;
+
+			vTaskSuspendAll();
+			size_t own = phase;
+			if (++arrived == expected) {
+				xTaskResumeAll();
+				Complete();
+				return true;
+			}
+			waiters.Add(w);
+			xTaskResumeAll();
+
+			if (waiters.Block(w, pdMS_TO_TICKS(wait_ms)))
+				return true;
+
+			vTaskSuspendAll();
+			/* Phase completed after our waiter was unlinked */
+			bool completed = phase != own;
+			bool completing = !completed && arrived == expected;
+			if (completing)
+				waiters.Add(w);
+			else if (!completed)
+				arrived--;
+			xTaskResumeAll();
+
+			if (completed)
+				return true;
+			/* Last task is running completion, release is near */
+			return completing && waiters.Block(w, portMAX_DELAY);
+		}
+	};
+
+	/**
+	 * @brief Storage for a result produced by another task.
+	 *
+	 * The value is constructed in place, no heap is used. The promise
+	 * must outlive all futures obtained from it.
+	 *
+	 * @tparam T		Type of result, may be void.
+	 */
+	template <class T>
+	class Promise
+	{
+	public:
+		using Ptr = typename std::add_pointer<T>::type;
+	protected:
+		struct Empty {};
+		using Value = typename std::conditional<std::is_void<T>::value,
+			Empty, T>::type;
+
+		alignas(Value) unsigned char storage[sizeof(Value)];
+		bool ready = false;
+		/* Set once then holds the continuation */
+		bool then_set = false;
+		InlineFunction<void(Ptr), FREERTOS_THEN_SIZE> then;
+		Latch done {1};
+
+		Ptr Get() {
+			if constexpr (std::is_void<T>::value)
+				return storage;
+			else
+				return std::launder(reinterpret_cast<T *>(storage));
+		}
+
+		template <class U> friend class Future;
+	public:
+		Promise() {}
+
+		/**
+		 * @brief Prevent class to be copied.
+		 */
+		Promise(const Promise &) = delete;
+
+		~Promise() {
+			if (ready)
+				std::launder(reinterpret_cast<Value *>(storage))
+					->~Value();
+		}
+
+		/**
+		 * @brief Store the result and release waiting tasks. Must be
+		 * called once.
+		 *
+		 * @param[in] args	T constructor arguments.
+		 */
+		template <typename... Args>
+		void SetValue(Args &&...args) {
+			configASSERT(!ready);
+			new (storage) Value(std::forward<Args>(args)...);
+
+			vTaskSuspendAll();
+			ready = true;
+			bool call = then_set;
+			xTaskResumeAll();
+
+			if (call)
+				then(Get());
+			done.CountDown();
+		}
+
+		/**
+		 * @brief Get future associated with this promise.
+		 */
+		Future<T> GetFuture() {
+			return Future<T>(this);
+		}
+	};
+
+	/**
+	 * @brief Read access to a result produced by another task.
+	 *
+	 * Futures are cheap to copy, all copies refer to the same Promise.
+	 *
+	 * @tparam T		Type of result, may be void.
+	 */
+	template <class T>
+	class Future
+	{
+	public:
+		using Ptr = typename Promise<T>::Ptr;
+	protected:
+		Promise<T> *promise = nullptr;
+	public:
+		/**
+		 * @brief Create future not associated with any promise.
+		 */
+		Future() {}
+
+		/**
+		 * @brief Create future associated with the promise.
+		 */
+		explicit Future(Promise<T> *promise) : promise(promise) {}
+
+		/**
+		 * @brief Check if future is associated with a promise.
+		 */
+		FREERTOS_NODISCARD
+		bool Valid() const {
+			return promise != nullptr;
+		}
+
+		/**
+		 * @brief Check if result is available.
+		 */
+		FREERTOS_NODISCARD
+		bool Ready() const {
+			return promise && promise->done.TryWait();
+		}
+
+		/**
+		 * @brief Wait for result.
+		 *
+		 * @param[in] wait_ms	[Optional] Time to wait in [ms].
+		 *
+		 * @return Pointer to result, nullptr on timeout.
+		 */
+		Ptr Get(size_t wait_ms = WAIT_MAX) {
+			return GetTicks(pdMS_TO_TICKS(wait_ms));
+		}
+
+		/**
+		 * @brief Wait for result.
+		 *
+		 * @param[in] ticks	Time to wait in ticks.
+		 *
+		 * @return Pointer to result, nullptr on timeout.
+		 */
+		Ptr GetTicks(TickType_t ticks) {
+			configASSERT(promise != nullptr);
+			if (!promise->done.WaitTicks(ticks))
+				return nullptr;
+			return promise->Get();
+		}
+
+		/**
+		 * @brief Set function to be called with the result.
+		 *
+		 * The function is called by the task setting the value, or
+		 * immediately by the caller if result is already available.
+		 * Only one continuation is supported, its captures must fit
+		 * into FREERTOS_THEN_SIZE bytes.
+		 *
+		 * @param[in] fn	Callable taking Ptr.
+		 */
+		template <class F>
+		void Then(F &&fn) {
+			configASSERT(promise != nullptr);
+			configASSERT(!promise->then);
+			/* Stored before it is published, SetValue() only
+			 * calls it after then_set */
+			promise->then.Emplace(std::forward<F>(fn));
+			vTaskSuspendAll();
+			bool ready = promise->ready;
+			if (!ready)
+				promise->then_set = true;
+			xTaskResumeAll();
+
+			if (ready)
+				promise->then(promise->Get());
+		}
+	};
+
+	/**
+	 * @brief Wait for all the futures to become ready.
+	 *
+	 * @param[in] wait_ms	Total time to wait in [ms].
+	 * @param[in] futures	Futures to wait for.
+	 *
+	 * @return true if all results are available, false on timeout.
+	 */
+	template <class... Futures>
+	bool WaitAll(size_t wait_ms, Futures &...futures) {
+		TickType_t ticks = pdMS_TO_TICKS(wait_ms);
+		TimeOut_t timeout;
+
+		vTaskSetTimeOutState(&timeout);
+		auto wait = [&](auto &f) {
+			xTaskCheckForTimeOut(&timeout, &ticks);
+			return f.GetTicks(ticks) != nullptr;
+		};
+		return (wait(futures) && ...);
+	}
+
+	/**
+	 * @brief Fixed set of jobs and worker tasks, base of ThreadPool and
+	 * AsyncExecutor.
+	 *
+	 * Free jobs wait in one queue, queued jobs are handed to the workers
+	 * through another one. Derived starts the workers with its own loop
+	 * once it is constructed, and implements Post().
+	 *
+	 * @tparam Derived	Executor implementation (CRTP).
+	 * @tparam workers	Number of worker tasks.
+	 * @tparam stack_size	Stack size of every worker in words.
+	 * @tparam jobs		Maximum amount of pending jobs.
+	 * @tparam job_size	Size in bytes of callable storage.
+	 * @tparam queue_size	Capacity of the queue feeding the workers.
+	 */
+	template <class Derived, size_t workers, size_t stack_size,
+	          size_t jobs, size_t job_size, size_t queue_size>
+	class JobExecutor
+	{
+		static_assert(workers != 0, "At least one worker is required");
+	protected:
+		using Worker = Task<stack_size>;
+
+		struct Job
+		{
+			InlineFunction<void(), job_size> fn;
+		};
+
+		Job job_pool[jobs];
+		QueueHandle_t free_jobs = nullptr;
+		QueueHandle_t queued = nullptr;
+#if (configSUPPORT_STATIC_ALLOCATION == 1)
+		StaticQueue_t free_buffer;
+		StaticQueue_t queued_buffer;
+		uint8_t free_storage[jobs * sizeof(Job *)];
+		uint8_t queued_storage[queue_size * sizeof(Job *)];
+#endif /* STATIC_ALLOCATION */
+		alignas(Worker) unsigned char worker_storage[workers]
+		                                            [sizeof(Worker)];
+
+		JobExecutor() {
+#if (configSUPPORT_STATIC_ALLOCATION == 1)
+			free_jobs = xQueueCreateStatic(jobs, sizeof(Job *),
+				free_storage, &free_buffer);
+			queued = xQueueCreateStatic(queue_size, sizeof(Job *),
+				queued_storage, &queued_buffer);
+#else /* STATIC_ALLOCATION */
+			free_jobs = xQueueCreate(jobs, sizeof(Job *));
+			queued = xQueueCreate(queue_size, sizeof(Job *));
+#endif /* STATIC_ALLOCATION */
+			configASSERT(free_jobs != nullptr && queued != nullptr);
+
+			for (Job &job : job_pool) {
+				Job *p = &job;
+				xQueueSend(free_jobs, &p, 0);
+			}
+		}
+
+		/**
+		 * @brief Delete worker tasks, pending jobs are dropped.
+		 */
+		~JobExecutor() {
+			for (size_t i = 0; i != workers; i++)
+				GetWorker(i).~Worker();
+			vQueueDelete(queued);
+			vQueueDelete(free_jobs);
+		}
+
+		/**
+		 * @brief Start worker tasks, called once by Derived
+		 * constructor.
+		 *
+		 * @param[in] name	Name of worker tasks.
+		 * @param[in] priority	Priority of worker tasks.
+		 */
+		void Start(const char *name, int priority) {
+			Derived &self = static_cast<Derived &>(*this);
+
+			for (size_t i = 0; i != workers; i++)
+				new (worker_storage[i]) Worker(
+					[&self, i] { self.Loop(i); },
+					name, priority);
+		}
+
+		Worker &GetWorker(size_t i) {
+			return *std::launder(
+				reinterpret_cast<Worker *>(worker_storage[i]));
+		}
+
+		/**
+		 * @brief Take a free job and store the callable in it.
+		 *
+		 * @return Job, nullptr if none got free in time.
+		 */
+		template <class F>
+		Job *Acquire(F &&fn, size_t wait_ms) {
+			Job *job;
+
+			if (xQueueReceive(free_jobs, &job,
+			                  pdMS_TO_TICKS(wait_ms)) != pdTRUE)
+				return nullptr;
+			job->fn.Emplace(std::forward<F>(fn));
+			return job;
+		}
+
+		/**
+		 * @brief Execute the job and return it to the free ones.
+		 */
+		void Run(Job *job) {
+			job->fn();
+			job->fn.Reset();
+			xQueueSend(free_jobs, &job, 0);
+		}
+	public:
+		/**
+		 * @brief Prevent class to be copied.
+		 */
+		JobExecutor(const JobExecutor &) = delete;
+
+		/**
+		 * @brief Submit a job producing a result.
+		 *
+		 * @param[in] promise	Storage for the result, must live
+		 *			until the job is done.
+		 * @param[in] fn	Callable returning R.
+		 * @param[in] wait_ms	[Optional] Time to wait for a free job
+		 *			slot in [ms].
+		 *
+		 * @return Future of the result, not valid if no job slot is
+		 * free.
+		 */
+		template <class R, class F>
+		Future<R> Submit(Promise<R> &promise, F &&fn,
+		                 size_t wait_ms = WAIT_MAX) {
+			auto job = [p = &promise, f = std::forward<F>(fn)]() mutable {
+				if constexpr (std::is_void<R>::value) {
+					f();
+					p->SetValue();
+				} else {
+					p->SetValue(f());
+				}
+			};
+			if (!static_cast<Derived &>(*this).Post(std::move(job),
+			                                         wait_ms))
+				return Future<R>();
+			return promise.GetFuture();
+		}
+
+#if (configUSE_CORE_AFFINITY == 1) && (configNUMBER_OF_CORES > 1)
+		/**
+		 * @brief Restrict a worker to a set of cores.
+		 *
+		 * @param[in] worker	Worker index.
+		 * @param[in] core_mask	Bit mask of allowed cores.
+		 */
+		void Pin(size_t worker, UBaseType_t core_mask) {
+			GetWorker(worker).SetAffinity(core_mask);
+		}
+#endif /* configUSE_CORE_AFFINITY */
+	};
+
+	/**
+	 * @brief Pool of worker tasks executing jobs with work stealing.
+	 *
+	 * Every worker owns a lock-free deque. Jobs posted by a worker go to
+	 * its own deque, jobs posted by other tasks go to a shared queue.
+	 * Idle workers steal from the other deques before blocking. Jobs are
+	 * taken from a fixed pool and store the callable inline.
+	 *
+	 * Requires lock-free 32-bit atomics (not available on Cortex-M0).
+	 *
+	 * @tparam workers	Number of worker tasks.
+	 * @tparam stack_size	[Optional] Stack size of every worker in words.
+	 * @tparam jobs		[Optional] Maximum amount of pending jobs,
+	 *			power of two.
+	 * @tparam job_size	[Optional] Size in bytes of callable storage.
+	 */
+	template <size_t workers,
+	          size_t stack_size = FREERTOS_DEFAULT_TASK_STACK_SIZE,
+	          size_t jobs = 16,
+	          size_t job_size = FREERTOS_JOB_SIZE>
+	class ThreadPool
+		: public JobExecutor<ThreadPool<workers, stack_size, jobs,
+		                                job_size>,
+		                     workers, stack_size, jobs, job_size,
+		                     /* Every job plus one wake-up per worker */
+		                     jobs + workers>
+	{
+		static_assert(jobs && !(jobs & (jobs - 1)),
+		              "Amount of jobs must be power of two");
+
+		using Base = JobExecutor<ThreadPool, workers, stack_size, jobs,
+		                         job_size, jobs + workers>;
+		friend Base;
+	protected:
+		using Job = typename Base::Job;
+		using Base::queued;
+		using Base::GetWorker;
+		using Base::Run;
+
+		/* Chase-Lev deque, only the owner pushes and pops */
+		struct Deque
+		{
+			std::atomic<int32_t> top {0};
+			std::atomic<int32_t> bottom {0};
+			std::atomic<Job *> items[jobs];
+
+			bool Push(Job *job) {
+				int32_t b = bottom.load(std::memory_order_relaxed);
+				int32_t t = top.load(std::memory_order_acquire);
+				if (b - t >= (int32_t)jobs)
+					return false;
+				items[b & (jobs - 1)].store(job,
+					std::memory_order_relaxed);
+				std::atomic_thread_fence(std::memory_order_release);
+				bottom.store(b + 1, std::memory_order_relaxed);
+				return true;
+			}
+
+			Job *Pop() {
+				int32_t b = bottom.load(std::memory_order_relaxed) - 1;
+				bottom.store(b, std::memory_order_relaxed);
+				std::atomic_thread_fence(std::memory_order_seq_cst);
+				int32_t t = top.load(std::memory_order_relaxed);
+				Job *job = nullptr;
+
+				if (t <= b) {
+					job = items[b & (jobs - 1)].load(
+						std::memory_order_relaxed);
+					if (t != b)
+						return job;
+					if (!top.compare_exchange_strong(t, t + 1,
+						std::memory_order_seq_cst,
+						std::memory_order_relaxed))
+						job = nullptr;
+				}
+				bottom.store(b + 1, std::memory_order_relaxed);
+				return job;
+			}
+
+			Job *Steal() {
+				int32_t t = top.load(std::memory_order_acquire);
+				std::atomic_thread_fence(std::memory_order_seq_cst);
+				int32_t b = bottom.load(std::memory_order_acquire);
+
+				if (t >= b)
+					return nullptr;
+				Job *job = items[t & (jobs - 1)].load(
+					std::memory_order_relaxed);
+				if (!top.compare_exchange_strong(t, t + 1,
+					std::memory_order_seq_cst,
+					std::memory_order_relaxed))
+					return nullptr;
+				return job;
+			}
+		};
+
+		Deque deques[workers];
+		std::atomic<size_t> idle {0};
+		std::atomic<size_t> wakeups {0};
+
+		int Self() {
+			TaskHandle_t self = xTaskGetCurrentTaskHandle();
+			for (size_t i = 0; i != workers; i++)
+				if (GetWorker(i).GetHandle() == self)
+					return i;
+			return -1;
+		}
+
+		void Loop(size_t self) {
+			while (1) {
+				Job *job = deques[self].Pop();
+				for (size_t i = 1; !job && i != workers; i++)
+					job = deques[(self + i) % workers].Steal();
+				if (!job) {
+					idle++;
+					xQueueReceive(queued, &job, portMAX_DELAY);
+					idle--;
+				}
+				/* nullptr is a wake-up to steal */
+				if (job)
+					Run(job);
+				else
+					wakeups--;
+			}
+		}
+	public:
+		/**
+		 * @brief Create the pool and start worker tasks.
+		 *
+		 * @param[in] name	[Optional] Name of worker tasks.
+		 * @param[in] priority	[Optional] Priority of worker tasks.
+		 */
+		explicit ThreadPool(const char *name = nullptr,
+		                    int priority = tskIDLE_PRIORITY + 1) {
+			this->Start(name, priority);
+		}
+
+		/**
+		 * @brief Post a job for execution.
+		 *
+		 * @param[in] fn	Callable taking no arguments.
+		 * @param[in] wait_ms	[Optional] Time to wait for a free job
+		 *			slot in [ms].
+		 *
+		 * @return true if posted, false if no job slot is free.
+		 */
+		template <class F>
+		bool Post(F &&fn, size_t wait_ms = WAIT_MAX) {
+			Job *job = this->Acquire(std::forward<F>(fn), wait_ms);
+			if (!job)
+				return false;
+
+			int self = Self();
+			if (self >= 0 && deques[self].Push(job)) {
+				/* At most one pending wake-up per worker */
+				if (idle) {
+					Job *wake = nullptr;
+					if (wakeups++ < workers)
+						xQueueSend(queued, &wake, 0);
+					else
+						wakeups--;
+				}
+				return true;
+			}
+			/* Never full, room for all jobs and wake-ups */
+			xQueueSend(queued, &job, portMAX_DELAY);
+			return true;
+		}
+	};
+
+	/**
+	 * @brief Long-lived worker tasks executing jobs from a FIFO queue.
+	 *
+	 * A lighter alternative to DoAsync for frequent jobs: posting only
+	 * fills a job record from a fixed pool, no task is created. Unlike
+	 * ThreadPool no atomics are needed.
+	 *
+	 * @tparam workers	Number of worker tasks.
+	 * @tparam stack_size	[Optional] Stack size of every worker in words.
+	 * @tparam jobs		[Optional] Maximum amount of pending jobs.
+	 * @tparam job_size	[Optional] Size in bytes of callable storage.
+	 */
+	template <size_t workers,
+	          size_t stack_size = FREERTOS_DEFAULT_TASK_STACK_SIZE,
+	          size_t jobs = 8,
+	          size_t job_size = FREERTOS_JOB_SIZE>
+	class AsyncExecutor
+		: public JobExecutor<AsyncExecutor<workers, stack_size, jobs,
+		                                   job_size>,
+		                     workers, stack_size, jobs, job_size, jobs>
+	{
+		using Base = JobExecutor<AsyncExecutor, workers, stack_size,
+		                         jobs, job_size, jobs>;
+		friend Base;
+	protected:
+		using Job = typename Base::Job;
+		using Base::queued;
+		using Base::Run;
+
+		void Loop(size_t) {
+			Job *job;
+
+			while (1)
+				if (xQueueReceive(queued, &job,
+				                  portMAX_DELAY) == pdTRUE)
+					Run(job);
+		}
+	public:
+		/**
+		 * @brief Create the executor and start worker tasks.
+		 *
+		 * @param[in] name	[Optional] Name of worker tasks.
+		 * @param[in] priority	[Optional] Priority of worker tasks.
+		 */
+		explicit AsyncExecutor(const char *name = nullptr,
+		                       int priority = tskIDLE_PRIORITY + 1) {
+			this->Start(name, priority);
+		}
+
+		/**
+		 * @brief Post a job for execution.
+		 *
+		 * @param[in] fn	Callable taking no arguments.
+		 * @param[in] wait_ms	[Optional] Time to wait for a free job
+		 *			slot in [ms].
+		 *
+		 * @return true if posted, false if no job slot is free.
+		 */
+		template <class F>
+		bool Post(F &&fn, size_t wait_ms = WAIT_MAX) {
+			Job *job = this->Acquire(std::forward<F>(fn), wait_ms);
+			if (!job)
+				return false;
+			/* Never blocks, the queue has room for every job */
+			xQueueSend(queued, &job, portMAX_DELAY);
+			return true;
+		}
+
+		/**
+		 * @brief Run a job producing a result, same as Submit().
+		 */
+		template <class R, class F>
+		Future<R> Async(Promise<R> &promise, F &&fn,
+		                size_t wait_ms = WAIT_MAX) {
+			return this->Submit(promise, std::forward<F>(fn),
+			                    wait_ms);
+		}
+
+		/**
+		 * @brief Get amount of jobs waiting for a worker.
+		 */
+		FREERTOS_NODISCARD
+		size_t Pending() const {
+			return uxQueueMessagesWaiting(queued);
+		}
+	};
+#endif /* FREERTOS_SYNC_NOTIFY */
+
+#if (INCLUDE_vTaskDelay == 1)
+	/**
+	 * @brief Suspend the task execution for given amount of milliseconds.
+	 *
+	 * @param[in] ms		Amount of milliseconds to wait.
+	 */
+	static inline void Delay_ms(size_t ms) {
+		vTaskDelay(pdMS_TO_TICKS(ms));
+	}
+
+#if (FREERTOS_SYNC_NOTIFY == 1)
+	/**
+	 * @brief Suspend the task execution unless stop is requested.
+	 *
+	 * Waits on notification FREERTOS_SYNC_NOTIFY_INDEX, which a stop
+	 * request gives. Like WaitList, stray notifications are tolerated.
+	 *
+	 * @param[in] ms		Amount of milliseconds to wait.
+	 * @param[in] token		Stop token to observe.
+	 *
+	 * @return true if the whole time elapsed, false on stop.
+	 */
+	static inline bool Delay_ms(size_t ms, const StopToken &token) {
+		TaskHandle_t self = xTaskGetCurrentTaskHandle();
+
+		token.Wait(ms, [self] {
+			xTaskNotifyGiveIndexed(self, FREERTOS_SYNC_NOTIFY_INDEX);
+		}, [](size_t slice) {
+			ulTaskNotifyTakeIndexed(FREERTOS_SYNC_NOTIFY_INDEX,
+			                        pdTRUE, pdMS_TO_TICKS(slice));
+			return false;
+		});
+		return !token.StopRequested();
+	}
+#endif /* FREERTOS_SYNC_NOTIFY */
+#endif /* INCLUDE_vTaskDelay */
+
+#if (INCLUDE_vTaskDelayUntil == 1)
+	/**
+	 * @brief Enables accurate periodic execution.
+	 */
+	class TimerDelay
+	{
+	protected:
+		TickType_t xLastWakeTime = 0;
+	public:
+		/**
+		 * @brief Constructor of TimerDelay class.
+		 *
+		 * @param start		Initiate at the moment of creation if enabled.
+		 */
+		TimerDelay(bool start = true) {
+			if (start)
+				Reset();
+		}
+
+		/**
+		 * @brief Reset the time stamp value.
+		 */
+		void Reset() {
+			xLastWakeTime = xTaskGetTickCount();
+		}
+
+		/**
+		 * Wait given amount ms since last call.
+		 *
+		 * @param ms Maximum waiting time in [ms].
+		 *
+		 * @return true if the task was delayed, false if the deadline
+		 * had already passed.
+		 */
+		bool Wait(size_t ms) {
+			return xTaskDelayUntil(&xLastWakeTime,
+			                       pdMS_TO_TICKS(ms)) == pdTRUE;
+		}
+
+		/**
+		 * @brief Drop periods that already passed, so the next Wait()
+		 * does not return at once for each of them.
+		 *
+		 * @param ms Period in [ms].
+		 *
+		 * @return Number of dropped periods.
+		 */
+		uint32_t Skip(size_t ms) {
+			TickType_t period = pdMS_TO_TICKS(ms);
+			TickType_t late = xTaskGetTickCount() - xLastWakeTime;
+			uint32_t missed = period ? late / period : 0;
+
+			xLastWakeTime += missed * period;
+			return missed;
+		}
+
+		/**
+		 * @brief Get the time the current period started, in ticks.
+		 */
+		FREERTOS_NODISCARD
+		TickType_t GetWakeTime() const {
+			return xLastWakeTime;
+		}
+	};
+
+	/**
+	 * @brief Timing statistics of a PeriodicTask.
+	 *
+	 * Execution times are in FREERTOS_PROFILING_CLOCK() units, release
+	 * jitter (delay between planned and actual start) is in ticks.
+	 */
+	struct PeriodicStats
+	{
+		uint32_t cycles = 0;
+		uint32_t overruns = 0;
+		uint32_t skipped = 0;
+		uint32_t exec_min = UINT32_MAX;
+		uint32_t exec_max = 0;
+		uint64_t exec_total = 0;
+		uint32_t jitter_min = UINT32_MAX;
+		uint32_t jitter_max = 0;
+		uint64_t jitter_total = 0;
+
+		FREERTOS_NODISCARD
+		uint32_t ExecAvg() const {
+			return cycles ? (uint32_t)(exec_total / cycles) : 0;
+		}
+
+		FREERTOS_NODISCARD
+		uint32_t JitterAvg() const {
+			return cycles ? (uint32_t)(jitter_total / cycles) : 0;
+		}
+	};
+
+	/**
+	 * @brief What a PeriodicTask does after missing a deadline.
+	 */
+	enum class OverrunPolicy : uint8_t
+	{
+		/** Run missed cycles back to back until on time again. */
+		CatchUp,
+		/** Drop missed cycles and continue with the next period. */
+		Skip,
+	};
+
+	/**
+	 * @brief Task running a function at a fixed period, with deadline
+	 * miss detection.
+	 *
+	 * @tparam stack_size		Stack size in words.
+	 * @tparam period_ms		Period in [ms].
+	 * @tparam functor_size		[Optional] Size in bytes of storage
+	 *				for the callable.
+	 */
+	template <size_t stack_size, size_t period_ms,
+	          size_t functor_size = FREERTOS_TASK_FUNCTOR_SIZE>
+	class PeriodicTask
+	{
+		static_assert(period_ms != 0, "Period must not be zero");
+	protected:
+		InlineFunction<void(), functor_size> body;
+		OverrunPolicy policy;
+		PeriodicStats stats;
+		Task<stack_size> task;
+
+		void Loop(StopToken stop) {
+			TimerDelay timer;
+
+			while (!stop.StopRequested()) {
+				TickType_t jitter = xTaskGetTickCount() -
+					timer.GetWakeTime();
+				uint32_t start = FREERTOS_PROFILING_CLOCK();
+				body();
+				uint32_t exec = FREERTOS_PROFILING_CLOCK() - start;
+				bool on_time = timer.Wait(period_ms);
+				uint32_t skipped = 0;
+
+				if (!on_time && policy == OverrunPolicy::Skip)
+					skipped = timer.Skip(period_ms);
+
+				taskENTER_CRITICAL();
+				stats.cycles++;
+				stats.overruns += !on_time;
+				stats.skipped += skipped;
+				if (exec < stats.exec_min)
+					stats.exec_min = exec;
+				if (exec > stats.exec_max)
+					stats.exec_max = exec;
+				stats.exec_total += exec;
+				if (jitter < stats.jitter_min)
+					stats.jitter_min = jitter;
+				if (jitter > stats.jitter_max)
+					stats.jitter_max = jitter;
+				stats.jitter_total += jitter;
+				taskEXIT_CRITICAL();
+			}
+		}
+	public:
+		/**
+		 * @brief Create the task, the first cycle starts at once.
+		 *
+		 * @param[in] fn	Callable executed every period.
+		 * @param[in] name	[Optional] Task name string.
+		 * @param[in] priority	[Optional] Task priority.
+		 * @param[in] policy	[Optional] Behaviour after an overrun.
+		 */
+		template <class F>
+		explicit PeriodicTask(F &&fn,
+			const char *name = nullptr,
+			int priority = tskIDLE_PRIORITY + 1,
+			OverrunPolicy policy = OverrunPolicy::CatchUp)
+			: body(std::forward<F>(fn)),
+			  policy(policy),
+			  task([this](StopToken stop) { Loop(stop); },
+			       name, priority) {}
+
+		/**
+		 * @brief Get a copy of timing statistics.
+		 */
+		FREERTOS_NODISCARD
+		PeriodicStats GetStats() {
+			taskENTER_CRITICAL();
+			PeriodicStats copy = stats;
+			taskEXIT_CRITICAL();
+			return copy;
+		}
+
+		/**
+		 * @brief Clear timing statistics.
+		 */
+		void ResetStats() {
+			taskENTER_CRITICAL();
+			stats = PeriodicStats();
+			taskEXIT_CRITICAL();
+		}
+
+		/**
+		 * @brief Get the underlying task, e.g. to stop and join it.
+		 */
+		FREERTOS_NODISCARD
+		Task<stack_size> &GetTask() {
+			return task;
+		}
+
+		/**
+		 * @brief Prevent class to be copied.
+		 */
+		PeriodicTask(const PeriodicTask &) = delete;
+	};
+
+	/**
+	 * @brief Description of a periodic task for TaskSet.
+	 *
+	 * Higher priority value means higher priority, as for Task.
+	 */
+	struct TaskSpec
+	{
+		const char *name;
+		/** Function called every period. */
+		void (*fn)();
+		int priority;
+		/** Stack size in words. */
+		size_t stack_size;
+		uint32_t period_ms;
+		/** Worst case execution time in [us]. */
+		uint32_t wcet_us;
+		/** Relative deadline in [ms], 0 means equal to period. */
+		uint32_t deadline_ms = 0;
+		/** Longest blocking by lower priority tasks in [us]. */
+		uint32_t blocking_us = 0;
+	};
+
+	/**
+	 * @brief Worst case response time of a task under fixed priority
+	 * preemptive scheduling (response time analysis).
+	 *
+	 * Tasks of equal priority are counted as interference, since the
+	 * kernel time slices between them.
+	 *
+	 * @param[in] table	Task set.
+	 * @param[in] i		Index of analysed task.
+	 *
+	 * @return Response time in [us], UINT64_MAX if the deadline can be
+	 * missed.
+	 */
+	template <size_t n>
+	constexpr uint64_t ResponseTime(const TaskSpec (&table)[n], size_t i) {
+		const TaskSpec &t = table[i];
+		uint64_t deadline = (uint64_t)(t.deadline_ms ? t.deadline_ms :
+		                               t.period_ms) * 1000;
+		uint64_t r = (uint64_t)t.wcet_us + t.blocking_us;
+		uint64_t prev = 0;
+
+		while (r != prev && r <= deadline) {
+			prev = r;
+			r = (uint64_t)t.wcet_us + t.blocking_us;
+			for (size_t j = 0; j != n; j++) {
+				uint64_t period = (uint64_t)table[j].period_ms * 1000;
+				if (j == i || table[j].priority < t.priority)
+					continue;
+				r += (prev + period - 1) / period * table[j].wcet_us;
+			}
+		}
+		return r <= deadline ? r : UINT64_MAX;
+	}
+
+	/**
+	 * @brief Check that every task of the set meets its deadline.
+	 *
+	 * @param[in] table	Task set.
+	 *
+	 * @return true if schedulable.
+	 */
+	template <size_t n>
+	constexpr bool Schedulable(const TaskSpec (&table)[n]) {
+		uint64_t load = 0;
+
+		for (size_t i = 0; i != n; i++) {
+			if (!table[i].period_ms)
+				return false;
+			/* In parts per million */
+			load += (uint64_t)table[i].wcet_us * 1000 /
+				table[i].period_ms;
+		}
+		if (load > 1000000)
+			return false;
+		for (size_t i = 0; i != n; i++)
+			if (ResponseTime(table, i) == UINT64_MAX)
+				return false;
+		return true;
+	}
+
+	/**
+	 * @brief Creates a PeriodicTask for every entry of a constexpr
+	 * TaskSpec table. Fails to compile if the set is not schedulable.
+	 *
+	 * @tparam table	Static constexpr array of TaskSpec.
+	 */
+	template <const auto &table>
+	class TaskSet
+	{
+		static constexpr size_t count =
+			sizeof(table) / sizeof(table[0]);
+
+		static_assert(Schedulable(table), "Task set is not schedulable");
+
+		template <size_t i>
+		struct Slot
+		{
+			static_assert(table[i].priority + tskIDLE_PRIORITY <
+				configMAX_PRIORITIES, "Priority out of range");
+
+			PeriodicTask<table[i].stack_size, table[i].period_ms> task {
+				table[i].fn, table[i].name, table[i].priority };
+		};
+
+		template <class>
+		struct Slots;
+
+		template <size_t... i>
+		struct Slots<std::index_sequence<i...>> : Slot<i>... {};
+
+		Slots<std::make_index_sequence<count>> slots;
+	public:
+		TaskSet() = default;
+
+		/**
+		 * @brief Get the task created for table entry i.
+		 */
+		template <size_t i>
+		FREERTOS_NODISCARD
+		PeriodicTask<table[i].stack_size, table[i].period_ms> &Get() {
+			return static_cast<Slot<i> &>(slots).task;
+		}
+
+		/**
+		 * @brief Prevent class to be copied.
+		 */
+		TaskSet(const TaskSet &) = delete;
+	};
+
+	/**
+	 * @brief Job of a CyclicExecutive schedule.
+	 */
+	struct CyclicJob
+	{
+		const char *name;
+		void (*fn)();
+		/** Period in minor frames. */
+		uint32_t period;
+		/** First minor frame the job runs in, less than period. */
+		uint32_t offset = 0;
+		/** Worst case execution time budget in [us]. */
+		uint32_t wcet_us = 0;
+	};
+
+	/**
+	 * @brief Frame table of a CyclicExecutive, computed at compile time.
+	 *
+	 * @tparam jobs		Static constexpr array of CyclicJob.
+	 * @tparam minor_ms	Minor frame length in [ms].
+	 */
+	template <const auto &jobs, size_t minor_ms>
+	class CyclicSchedule
+	{
+	public:
+		static constexpr size_t job_count = sizeof(jobs) / sizeof(jobs[0]);
+
+		static constexpr bool valid = [] {
+			for (const CyclicJob &job : jobs)
+				if (!job.fn || !job.period || job.offset >= job.period)
+					return false;
+			return true;
+		}();
+
+		static_assert(valid, "Every job needs a function, a period "
+			"and an offset below the period");
+
+		/** Major frame length in minor frames, the least common
+		 * multiple of all periods. */
+		static constexpr size_t major = [] {
+			size_t m = 1;
+
+			for (const CyclicJob &job : jobs) {
+				size_t a = m;
+				size_t b = job.period;
+				while (b) {
+					size_t t = a % b;
+					a = b;
+					b = t;
+				}
+				m = m / a * job.period;
+			}
+			return m;
+		}();
+
+		static constexpr size_t entry_count = [] {
+			size_t n = 0;
+
+			for (const CyclicJob &job : jobs)
+				n += major / job.period;
+			return n;
+		}();
+
+		static_assert(job_count != 0 && entry_count < UINT16_MAX,
+			"Schedule is empty or too large");
+
+		/** Entries of frame f are entries[first[f]] up to
+		 * entries[first[f + 1]]. */
+		uint16_t first[major + 1];
+		/** Job index of every entry. */
+		uint16_t entries[entry_count];
+		/** Sum of WCET budgets of each frame in [us]. */
+		uint32_t load_us[major];
+
+		constexpr CyclicSchedule()
+			: first(), entries(), load_us() {
+			size_t n = 0;
+
+			for (size_t f = 0; f != major; f++) {
+				first[f] = static_cast<uint16_t>(n);
+				for (size_t j = 0; j != job_count; j++) {
+					if (f % jobs[j].period != jobs[j].offset)
+						continue;
+					entries[n++] = static_cast<uint16_t>(j);
+					load_us[f] += jobs[j].wcet_us;
+				}
+			}
+			first[major] = static_cast<uint16_t>(n);
+		}
+
+		/**
+		 * @brief Check if WCET budgets of every frame fit into the
+		 * minor frame.
+		 */
+		constexpr bool Fits() const {
+			for (size_t f = 0; f != major; f++)
+				if (load_us[f] > minor_ms * 1000)
+					return false;
+			return true;
+		}
+	};
+
+	/**
+	 * @brief Timing of a minor frame of CyclicExecutive.
+	 *
+	 * Times are in FREERTOS_PROFILING_CLOCK() units. Slack is the frame
+	 * length minus the execution time, negative after an overrun.
+	 */
+	struct FrameStats
+	{
+		uint32_t runs = 0;
+		uint32_t overruns = 0;
+		/** Frames dropped after an overrun of this frame. */
+		uint32_t skipped = 0;
+		uint32_t exec_min = UINT32_MAX;
+		uint32_t exec_max = 0;
+		uint64_t exec_total = 0;
+		int32_t slack_min = INT32_MAX;
+
+		FREERTOS_NODISCARD
+		uint32_t ExecAvg() const {
+			return runs ? (uint32_t)(exec_total / runs) : 0;
+		}
+	};
+
+	/**
+	 * @brief Time triggered scheduler running a static frame table inside
+	 * a single task.
+	 *
+	 * Every minor frame runs its jobs back to back and waits for the next
+	 * frame with TimerDelay. A frame finishing late counts as an overrun,
+	 * frames whose start already passed are dropped so the table stays
+	 * aligned to time. Compilation fails if WCET budgets of a frame exceed
+	 * its length, or the frame is not a whole number of ticks.
+	 *
+	 * @tparam jobs		Static constexpr array of CyclicJob.
+	 * @tparam minor_ms	Minor frame length in [ms].
+	 * @tparam stack_size	[Optional] Task stack size.
+	 */
+	template <const auto &jobs, size_t minor_ms,
+	          size_t stack_size = FREERTOS_DEFAULT_TASK_STACK_SIZE>
+	class CyclicExecutive
+	{
+		static_assert(minor_ms != 0, "Minor frame must not be zero");
+		static_assert((minor_ms * configTICK_RATE_HZ) % 1000 == 0 &&
+			minor_ms * configTICK_RATE_HZ >= 1000,
+			"Minor frame must be a whole number of ticks");
+	public:
+		using Schedule = CyclicSchedule<jobs, minor_ms>;
+		static constexpr Schedule schedule {};
+		static constexpr size_t major = Schedule::major;
+
+		static_assert(schedule.Fits(), "Frame budget exceeded");
+	protected:
+		/* Minor frame length in FREERTOS_PROFILING_CLOCK() units */
+		static constexpr int32_t frame_clocks = (int32_t)(
+			(uint64_t)minor_ms * FREERTOS_PROFILING_CLOCK_HZ / 1000);
+		static_assert((uint64_t)minor_ms * FREERTOS_PROFILING_CLOCK_HZ /
+			1000 <= INT32_MAX, "Minor frame too long for the "
+			"profiling clock");
+
+		FrameStats stats[major];
+		Task<stack_size> task;
+
+		void Loop(StopToken stop) {
+			TimerDelay timer;
+			size_t frame = 0;
+
+			while (!stop.StopRequested()) {
+				uint32_t start = FREERTOS_PROFILING_CLOCK();
+				for (size_t i = schedule.first[frame];
+				     i != schedule.first[frame + 1]; i++)
+					jobs[schedule.entries[i]].fn();
+				uint32_t exec = FREERTOS_PROFILING_CLOCK() - start;
+				int32_t slack = frame_clocks - (int32_t)exec;
+				bool on_time = timer.Wait(minor_ms);
+				uint32_t skipped = on_time ? 0 : timer.Skip(minor_ms);
+
+				taskENTER_CRITICAL();
+				FrameStats &s = stats[frame];
+				s.runs++;
+				s.overruns += !on_time;
+				s.skipped += skipped;
+				if (exec < s.exec_min)
+					s.exec_min = exec;
+				if (exec > s.exec_max)
+					s.exec_max = exec;
+				s.exec_total += exec;
+				if (slack < s.slack_min)
+					s.slack_min = slack;
+				taskEXIT_CRITICAL();
+
+				frame = (frame + 1 + skipped) % major;
+			}
+		}
+	public:
+		/**
+		 * @brief Create the task, the first major frame starts at once.
+		 *
+		 * @param[in] name	[Optional] Task name string.
+		 * @param[in] priority	[Optional] Task priority.
+		 */
+		explicit CyclicExecutive(const char *name = nullptr,
+			int priority = configMAX_PRIORITIES - 1)
+			: task([this](StopToken stop) { Loop(stop); },
+			       name, priority) {}
+
+		/**
+		 * @brief Get a copy of timing statistics of a minor frame.
+		 *
+		 * @param[in] frame	Frame index, less than major.
+		 */
+		FREERTOS_NODISCARD
+		FrameStats GetStats(size_t frame) {
+			configASSERT(frame < major);
+			taskENTER_CRITICAL();
+			FrameStats copy = stats[frame];
+			taskEXIT_CRITICAL();
+			return copy;
+		}
+
+		/**
+		 * @brief Clear timing statistics of all frames.
+		 */
+		void ResetStats() {
+			taskENTER_CRITICAL();
+			for (FrameStats &s : stats)
+				s = FrameStats();
+			taskEXIT_CRITICAL();
+		}
+
+		/**
+		 * @brief Get the underlying task, e.g. to stop and join it.
+		 */
+		FREERTOS_NODISCARD
+		Task<stack_size> &GetTask() {
+			return task;
+		}
+
+		/**
+		 * @brief Prevent class to be copied.
+		 */
+		CyclicExecutive(const CyclicExecutive &) = delete;
+	};
+#endif
+
+#if (INCLUDE_vTaskDelayUntil == 1)
+	/**
+	 * @brief Task running Watchdog::Check() periodically. While all tasks
+	 * are alive it feeds the hardware watchdog, after a stall it reports
+	 * and escalates instead.
+	 *
+	 * @tparam stack_size	[Optional] Task stack size.
+	 */
+	template <size_t stack_size = FREERTOS_DEFAULT_TASK_STACK_SIZE>
+	class WatchdogSupervisor
+	{
+	protected:
+		size_t period_ms;
+		void (*report)(const Watchdog::Stall &stall);
+		void (*escalate)(size_t stalled);
+		void (*feed)();
+		Task<stack_size> task;
+
+		void Loop(StopToken stop) {
+			TimerDelay timer;
+
+			while (!stop.StopRequested()) {
+				size_t stalled = Watchdog::Check(report);
+
+				if (stalled) {
+					if (escalate)
+						escalate(stalled);
+				} else if (feed) {
+					feed();
+				}
+				timer.Wait(period_ms);
+			}
+		}
+	public:
+		/**
+		 * @brief Create the supervisor task.
+		 *
+		 * @param[in] period_ms	Checking period in [ms].
+		 * @param[in] report	Called once per stalled task.
+		 * @param[in] escalate	[Optional] Called every period while
+		 *			any task is stalled.
+		 * @param[in] feed	[Optional] Called every period while
+		 *			all tasks are alive.
+		 * @param[in] priority	[Optional] Task priority.
+		 */
+		WatchdogSupervisor(size_t period_ms,
+			void (*report)(const Watchdog::Stall &stall),
+			void (*escalate)(size_t stalled) = nullptr,
+			void (*feed)() = nullptr,
+			int priority = configMAX_PRIORITIES - 1)
+			: period_ms(period_ms), report(report),
+			  escalate(escalate), feed(feed),
+			  task([this](StopToken stop) { Loop(stop); },
+			       "wdog", priority) {}
+
+		/**
+		 * @brief Get the underlying task.
+		 */
+		FREERTOS_NODISCARD
+		Task<stack_size> &GetTask() {
+			return task;
+		}
+
+		/**
+		 * @brief Prevent class to be copied.
+		 */
+		WatchdogSupervisor(const WatchdogSupervisor &) = delete;
+	};
+#endif /* INCLUDE_vTaskDelayUntil */
+
+	/**
+	 * @brief Creates a new FreeRTOS queue instance.
+	 *
+	 * @Note This is MPSC queue (multi producers, single consumer queue).
+	 * If you need to use MPMC queue, you have to block the kernel until
+	 * popped pointer is processed or copied.
+	 *
+	 * Producers reserve a slot with compare and swap, construct the item
+	 * in place and then publish it, so no lock is taken and items are
+	 * never constructed with interrupts masked.
+	 *
+	 * @tparam T		Type of object to be enqueued.
+	 * @tparam size		Maximum queue size
+	 *			(maximum amount of object to store).
+	 */
+	template <class T, size_t size = 2>
+	class Queue
+	{
+	protected:
+#if (configSUPPORT_STATIC_ALLOCATION == 1)
+		StaticQueue_t xStaticQueue;
+#endif /* STATIC_ALLOCATION */
+		CountingSemaphore semaphore;
+		T buffer[size];
+		/* Set once the item in the slot is constructed */
+		std::atomic<bool> ready[size] = {};
+		std::atomic<size_t> rd_idx {0};
+		/* Next slot to reserve */
+		std::atomic<size_t> wr_idx {0};
+		friend class CoroutineScheduler;
+
+		bool Available() const noexcept {
+			return ready[rd_idx.load(std::memory_order_relaxed)].load(
+				std::memory_order_acquire);
+		}
+
+		/* Returns slot index or size when full */
+		size_t Reserve() noexcept {
+			size_t wr = wr_idx.load(std::memory_order_relaxed);
+			size_t next;
+
+			do {
+				next = wr + 1 == size ? 0 : wr + 1;
+				if (next == rd_idx.load(std::memory_order_acquire))
+					return size;
+			} while (!wr_idx.compare_exchange_weak(wr, next,
+					std::memory_order_relaxed,
+					std::memory_order_relaxed));
+			return wr;
+		}
+
+		template <typename... Args>
+		bool Emplace(Args &&...args) noexcept (
+			std::is_nothrow_constructible<T, Args &&...>::value) {
+			static_assert(
+				std::is_constructible<T, Args &&...>::value,
+				"T must be constructible with Args&&...");
+
+			size_t slot;
+
+			if constexpr (std::is_nothrow_constructible<T,
+					Args &&...>::value) {
+				slot = Reserve();
+				if (slot == size)
+					return false;
+				new (&buffer[slot]) T(std::forward<Args>(args)...);
+			} else {
+				/* A throwing constructor must not leave a
+				 * reserved slot behind, build the item first */
+				static_assert(
+					std::is_nothrow_move_constructible<T>::value,
+					"T must be nothrow constructible with "
+					"Args&&... or nothrow move constructible");
+				T item(std::forward<Args>(args)...);
+				slot = Reserve();
+				if (slot == size)
+					return false;
+				new (&buffer[slot]) T(std::move(item));
+			}
+			ready[slot].store(true, std::memory_order_release);
+			return true;
+		}
+	public:
+		/**
+		 * @brief Default constructor.
+		 */
+		Queue() : Queue(nullptr) {}
+
+		/**
+		 * @brief Creates a named queue.
+		 *
+		 * @param[in] name	Name used by profiling and tracing
+		 *			reports.
+		 */
+		explicit Queue(const char *name)
+			: semaphore(0, size, name) {
+#if (FREERTOS_BLOCKING_TRACE == 1)
+			semaphore.trace_kind = BlockKind::Queue;
+#endif /* FREERTOS_BLOCKING_TRACE */
+		}
+
+#if (FREERTOS_DEFERRED_INIT == 1)
+		/**
+		 * @brief Constant initialize without creating kernel objects.
+		 *
+		 * @param[in] name	[Optional] Name used by profiling and
+		 *			tracing reports.
+		 */
+		constexpr explicit Queue(DeferredInit, const char *name = nullptr)
+			:
+#if (configSUPPORT_STATIC_ALLOCATION == 1)
+			  xStaticQueue(),
+#endif /* STATIC_ALLOCATION */
+			  semaphore(Deferred, 0, size, name), buffer(), ready() {}
+
+		/**
+		 * @brief Create kernel objects of a deferred queue.
+		 */
+		void Init() {
+			semaphore.Init();
+#if (FREERTOS_BLOCKING_TRACE == 1)
+			semaphore.trace_kind = BlockKind::Queue;
+#endif /* FREERTOS_BLOCKING_TRACE */
+		}
+#endif /* FREERTOS_DEFERRED_INIT */
+
+		/**
+		 * @brief Prevent class to be copied or moved.
+		 */
+		Queue(const Queue&) = delete;
+		Queue(Queue&&) = delete;
+
+		/**
+		 * @brief Construct an item at the back place of a queue.
+		 *
+		 * Other tasks and interrupts can post at the same time. This
+		 * function must not be called from an interrupt service
+		 * routine.
+		 *
+		 * @param[in] args	T constructor arguments.
+		 * @return true if item posted in the queue,
+		 * false when no space left.
+		 */
+		template <typename... Args>
+		bool TryEmplaceBack(Args &&...args) noexcept (
+			std::is_nothrow_constructible<T, Args &&...>::value) {
+			bool posted = Emplace(std::forward<Args>(args)...);
+			if (posted)
+				semaphore.Give();
+			return posted;
+		}
+
+		/**
+		 * @brief Construct an item at the back place of a queue from
+		 * interrupt context.
+		 *
+		 * @param[out] woken	Set to pdTRUE if a context switch
+		 *			should be requested before the
+		 *			interrupt exits, may be nullptr.
+		 * @param[in] args	T constructor arguments.
+		 * @return true if item posted in the queue,
+		 * false when no space left.
+		 */
+		template <typename... Args>
+		bool TryEmplaceBackFromISR(BaseType_t *woken,
+		                           Args &&...args) noexcept (
+			std::is_nothrow_constructible<T, Args &&...>::value) {
+			bool posted = Emplace(std::forward<Args>(args)...);
+			if (posted)
+				semaphore.GiveFromISR(woken);
+			return posted;
+		}
+
+		/**
+		 * @brief Post an item to the back of a queue.
+		 *
+		 * This function must not be called from an interrupt service
+		 * routine.
+		 *
+		 * @param[in] item	Pointer to item to post.
+		 *
+		 * @return true if item posted in the queue, false when
+		 * no space left.
+		 */
+		bool TryPushBack(const T &item) noexcept {
+			return TryEmplaceBack(item);
+		}
+
+		/**
+		 * @brief Get number of items in the queue.
+		 */
+		FREERTOS_NODISCARD
+		size_t Count() const noexcept {
+			size_t wr = wr_idx.load(std::memory_order_relaxed);
+			size_t rd = rd_idx.load(std::memory_order_relaxed);
+
+			return wr >= rd ? wr - rd : size - rd + wr;
+		}
+
+		/**
+		 * @brief Receive an item from a queue.
+		 *
+		 * @param[in] wait_ms	[Optional] The maximum amount of time
+		 *			the task should block waiting for an
+		 *			item to appear in the queue.
+		 *
+		 * @return Pointer to item in the buffer or nullptr if queue is
+		 * empty.
+		 */
+		T* Front(size_t wait_ms = 0) noexcept {
+			/* Items consumed without blocking leave their count in
+			 * the semaphore, so check again after every wake up. */
+			while (!Available()) {
+				if (!wait_ms || !semaphore.Take(wait_ms))
+					return nullptr;
+			}
+
+			return &buffer[rd_idx.load(std::memory_order_relaxed)];
+		}
+
+		/**
+		 * @brief Receive an item from a queue unless stop is
+		 * requested.
+		 *
+		 * @param[in] wait_ms	The maximum amount of time to wait.
+		 * @param[in] token	Stop token to observe.
+		 *
+		 * @return Pointer to item in the buffer or nullptr on timeout
+		 * or stop.
+		 */
+		T* Front(size_t wait_ms, const StopToken &token) noexcept {
+			/* A stop request gives the semaphore, the extra count
+			 * is tolerated like the ones of consumed items. */
+			if (!token.Wait(wait_ms, [this] { semaphore.Give(); },
+				[this](size_t ms) {
+					return Available() ||
+						(semaphore.Take(ms) &&
+						 Available());
+				}))
+				return nullptr;
+			return Front();
+		}
+
+		void Pop() noexcept {
+			static_assert(std::is_nothrow_destructible<T>::value,
+					"T must be nothrow destructible");
+			size_t rd = rd_idx.load(std::memory_order_relaxed);
+
+			buffer[rd].~T();
+			ready[rd].store(false, std::memory_order_relaxed);
+			rd_idx.store(rd + 1 == size ? 0 : rd + 1,
+			             std::memory_order_release);
+		}
+	};
+
+	/**
+	 * @brief Task with an inbox, dispatching every message to an overload
+	 * of Derived::Handle() chosen by std::visit. No virtual calls.
+	 *
+	 * Derived implements void Handle(M &) (or const M &) for every
+	 * alternative M of Message, and may hide OnDrained(size_t count),
+	 * which is called when a batch of messages was handled. Handlers only
+	 * run for received messages, so the task may start before Derived is
+	 * fully constructed.
+	 *
+	 * @tparam Derived	Actor implementation (CRTP).
+	 * @tparam Message	std::variant of message types.
+	 * @tparam depth	[Optional] Inbox capacity.
+	 * @tparam stack_size	[Optional] Task stack size.
+	 */
+	template <class Derived, class Message, size_t depth = 8,
+	          size_t stack_size = FREERTOS_DEFAULT_TASK_STACK_SIZE>
+	class Actor
+	{
+	public:
+		static constexpr size_t types = std::variant_size<Message>::value;
+
+		/**
+		 * @brief Message statistics. Times are in
+		 * FREERTOS_PROFILING_CLOCK units.
+		 */
+		struct Stats
+		{
+			uint32_t handled = 0;
+			uint32_t dropped = 0;
+			uint32_t batches = 0;
+			uint32_t batch_max = 0;
+			/** Highest amount of queued messages seen. */
+			uint32_t pending_max = 0;
+			uint32_t handle_max = 0;
+			uint64_t handle_total = 0;
+			uint32_t by_type[types] = {};
+		};
+	protected:
+		Queue<Message, depth + 1> inbox;
+		size_t batch_limit;
+		Stats stats;
+		std::atomic<uint32_t> dropped {0};
+		Task<stack_size> task;
+
+		/**
+		 * @brief Default batch hook, does nothing.
+		 */
+		void OnDrained(size_t count) {
+			(void)count;
+		}
+
+		void Loop(StopToken stop) {
+			Derived &self = static_cast<Derived &>(*this);
+
+			while (!stop.StopRequested()) {
+				Message *msg = inbox.Front(WAIT_MAX, stop);
+				if (!msg)
+					continue;
+
+				uint32_t pending = inbox.Count();
+				uint32_t count = 0;
+				do {
+					size_t type = msg->index();
+					uint32_t start = FREERTOS_PROFILING_CLOCK();
+					std::visit([&self](auto &m) {
+						self.Handle(m);
+					}, *msg);
+					uint32_t time = FREERTOS_PROFILING_CLOCK() - start;
+					inbox.Pop();
+					count++;
+
+					taskENTER_CRITICAL();
+					stats.handled++;
+					stats.by_type[type]++;
+					stats.handle_total += time;
+					if (time > stats.handle_max)
+						stats.handle_max = time;
+					taskEXIT_CRITICAL();
+				} while (count < batch_limit && (msg = inbox.Front()));
+
+				taskENTER_CRITICAL();
+				stats.batches++;
+				if (count > stats.batch_max)
+					stats.batch_max = count;
+				if (pending > stats.pending_max)
+					stats.pending_max = pending;
+				taskEXIT_CRITICAL();
+				self.OnDrained(count);
+			}
+		}
+	public:
+		/**
+		 * @brief Create the inbox and start the task.
+		 *
+		 * @param[in] name	[Optional] Task and inbox name.
+		 * @param[in] priority	[Optional] Task priority.
+		 * @param[in] batch	[Optional] Maximum amount of messages
+		 *			handled before OnDrained() is called.
+		 */
+		explicit Actor(const char *name = nullptr,
+			int priority = tskIDLE_PRIORITY + 1,
+			size_t batch = depth)
+			: inbox(name), batch_limit(batch ? batch : 1),
+			  task([this](StopToken stop) { Loop(stop); },
+			       name, priority) {}
+
+		/**
+		 * @brief Post a message, constructed in place in the inbox.
+		 *
+		 * @param[in] msg	Message of any alternative type.
+		 *
+		 * @return true if posted, false if the inbox is full.
+		 */
+		template <class M>
+		bool Send(M &&msg) {
+			if (inbox.TryEmplaceBack(std::forward<M>(msg)))
+				return true;
+			dropped.fetch_add(1, std::memory_order_relaxed);
+			return false;
+		}
+
+		/**
+		 * @brief Construct a message of type M in the inbox.
+		 *
+		 * @param[in] args	M constructor arguments.
+		 *
+		 * @return true if posted, false if the inbox is full.
+		 */
+		template <class M, class... Args>
+		bool Emplace(Args &&...args) {
+			if (inbox.TryEmplaceBack(std::in_place_type<M>,
+			                         std::forward<Args>(args)...))
+				return true;
+			dropped.fetch_add(1, std::memory_order_relaxed);
+			return false;
+		}
+
+		/**
+		 * @brief Post a message from interrupt context.
+		 *
+		 * @param[in] msg	Message of any alternative type.
+		 * @param[out] woken	[Optional] Set to pdTRUE if a context
+		 *			switch should be requested before the
+		 *			interrupt exits.
+		 *
+		 * @return true if posted, false if the inbox is full.
+		 */
+		template <class M>
+		bool SendFromISR(M &&msg, BaseType_t *woken = nullptr) {
+			if (inbox.TryEmplaceBackFromISR(woken,
+			                                std::forward<M>(msg)))
+				return true;
+			dropped.fetch_add(1, std::memory_order_relaxed);
+			return false;
+		}
+
+		/**
+		 * @brief Get a copy of message statistics.
+		 */
+		FREERTOS_NODISCARD
+		Stats GetStats() {
+			taskENTER_CRITICAL();
+			Stats copy = stats;
+			taskEXIT_CRITICAL();
+			copy.dropped = dropped.load(std::memory_order_relaxed);
+			return copy;
+		}
+
+		/**
+		 * @brief Get the underlying task, e.g. to stop and join it.
+		 */
+		FREERTOS_NODISCARD
+		Task<stack_size> &GetTask() {
+			return task;
+		}
+
+		/**
+		 * @brief Prevent class to be copied.
+		 */
+		Actor(const Actor &) = delete;
+	};
+
+#if (configUSE_TIMERS == 1)
+	/**
+	 * @brief FreeRTOS software timer.
+	 */
+	class Timer
+	{
+	protected:
+		TimerHandle_t handle = nullptr;
+#if (configSUPPORT_STATIC_ALLOCATION == 1)
+		StaticTimer_t xTimerBuffers;
+#endif
+#if (FREERTOS_DEFERRED_INIT == 1)
+		void (*init_callback)(TimerHandle_t) = nullptr;
+		size_t init_period_ms = 0;
+		bool init_autoreload = false;
+		const char *init_name = nullptr;
+		void *init_id = nullptr;
+#endif /* FREERTOS_DEFERRED_INIT */
+
+		void Create(void (*callback)(TimerHandle_t), size_t period_ms,
+		            bool autoreload, const char *name, void *timer_id) {
+#if (configSUPPORT_STATIC_ALLOCATION == 1)
+			handle = xTimerCreateStatic(name,
+				pdMS_TO_TICKS(period_ms),
+				autoreload, timer_id,
+				callback, &xTimerBuffers);
+#else /* STATIC_ALLOCATION */
+			handle = xTimerCreate(name,
+				pdMS_TO_TICKS(period_ms),
+				autoreload, timer_id,
+				callback);
+#endif /* STATIC_ALLOCATION */
+			configASSERT(handle != nullptr);
+		}
+	public:
+		/**
+		 * @brief Creates instance of software timer.
+		 *
+		 * @param[in] callback		The function to call when the
+		 *				timer expires.
+		 * @param[in] period_ms		Timer expire time in [ms].
+		 * @param[in] autoreload	false to single shot, true for
+		 *				repeat.
+		 * @param[in] name		Timer name string for debugging
+		 *				purpose.
+		 * @param[in] timer_id		An identifier that is assigned
+		 *				to the timer being created.
+		 *				Typically this would be used
+		 *				in the timer callback function
+		 *				to identify which timer expired
+		 *				when the same callback function
+		 *				is assigned to more than one
+		 *				timer.
+		 */
+		Timer(void (*callback)(TimerHandle_t handle),
+			size_t period_ms,
+			bool autoreload = true,
+			const char *name = nullptr,
+			void *timer_id = nullptr) {
+			Create(callback, period_ms, autoreload, name, timer_id);
+		}
+
+#if (FREERTOS_DEFERRED_INIT == 1)
+		/**
+		 * @brief Constant initialize without creating the timer,
+		 * parameters as for the regular constructor.
+		 */
+		constexpr Timer(DeferredInit,
+			void (*callback)(TimerHandle_t handle),
+			size_t period_ms,
+			bool autoreload = true,
+			const char *name = nullptr,
+			void *timer_id = nullptr)
+			:
+#if (configSUPPORT_STATIC_ALLOCATION == 1)
+			  xTimerBuffers(),
+#endif /* STATIC_ALLOCATION */
+			  init_callback(callback), init_period_ms(period_ms),
+			  init_autoreload(autoreload), init_name(name),
+			  init_id(timer_id) {}
+
+		/**
+		 * @brief Create the timer of a deferred object.
+		 */
+		void Init() {
+			configASSERT(handle == nullptr);
+			Create(init_callback, init_period_ms, init_autoreload,
+			       init_name, init_id);
+		}
+#endif /* FREERTOS_DEFERRED_INIT */
+
+		/**
+		 * @brief Delete timer and release allocated memory.
+		 */
+		~Timer() {
+			Delete();
+		}
+
+		/**
+		 * @brief Prevent class to be copied.
+		 */
+		Timer(const Timer &) = delete;
+
+		/**
+		 * @brief Delete timer and release allocated memory.
+		 */
+		void Delete(size_t wait_ms = 0) {
+			if (handle)
+				configASSERT(xTimerDelete(handle,
+					pdMS_TO_TICKS(wait_ms)) == pdPASS);
+			handle = nullptr;
+		}
+
+		/**
+		 * @brief Start the timer.
+		 *
+		 * wait_ms		[Optional] Time after the timer should
+		 *			start.
+		 */
+		void Start(size_t wait_ms = 0) {
+			configASSERT(xTimerStart(handle,
+				pdMS_TO_TICKS(wait_ms)) == pdPASS);
+		}
+
+		/**
+		 * @brief Stop the timer.
+		 *
+		 * @param[in] wait_ms		[Optional] Specifies the time,
+		 *				in [ms], that the calling task
+		 *				should be held in the Blocked
+		 *				state to wait for the stop
+		 *				command to be successfully.
+		 */
+
+		void Stop(size_t wait_ms = 0) {
+			configASSERT(xTimerStop(handle,
+				pdMS_TO_TICKS(wait_ms)) == pdPASS);
+		}
+
+		/**
+		 * @brief Change the period and (re)start the timer.
+		 *
+		 * @param[in] period_ms		New period in [ms].
+		 * @param[in] wait_ms		[Optional] Time to wait for
+		 *				space in the timer command
+		 *				queue in [ms].
+		 */
+		void SetPeriod(size_t period_ms, size_t wait_ms = 0) {
+			BaseType_t result = xTimerChangePeriod(handle,
+				pdMS_TO_TICKS(period_ms), pdMS_TO_TICKS(wait_ms));
+			configASSERT(result == pdPASS);
+			(void)result;
+		}
+
+		/**
+		 * @brief Restart the timer, the period counts from now.
+		 *
+		 * @param[in] wait_ms		[Optional] Time to wait for
+		 *				space in the timer command
+		 *				queue in [ms].
+		 */
+		void Reset(size_t wait_ms = 0) {
+			BaseType_t result = xTimerReset(handle,
+				pdMS_TO_TICKS(wait_ms));
+			configASSERT(result == pdPASS);
+			(void)result;
+		}
+
+		/**
+		 * @brief Get kernel handle of the timer.
+		 */
+		FREERTOS_NODISCARD
+		TimerHandle_t GetHandle() const {
+			return handle;
+		}
+	};
+#endif /* configUSE_TIMERS */
+
+	/**
+	 * @brief State of a StateMachine table.
+	 *
+	 * @tparam Context	Type passed to all actions and guards.
+	 * @tparam State	Enum of states, values 0 to N - 1.
+	 * @tparam Event	Enum of events, small values.
+	 */
+	template <class Context, class State, class Event>
+	struct StateSpec
+	{
+		State id;
+		/** Enclosing state, id itself for a top level state. */
+		State parent;
+		/** Child entered when the state is targeted, id itself for a
+		 * leaf state. */
+		State initial;
+		void (*entry)(Context &) = nullptr;
+		void (*exit)(Context &) = nullptr;
+		/** Time in the state after which timeout is dispatched, 0 to
+		 * disable. */
+		size_t timeout_ms = 0;
+		Event timeout = Event();
+	};
+
+	/**
+	 * @brief Transition of a StateMachine table. A transition of a
+	 * composite state applies to all its children. Transitions sharing
+	 * state and event are tried in table order until a guard passes.
+	 */
+	template <class Context, class State, class Event>
+	struct TransitionSpec
+	{
+		State from;
+		Event event;
+		State to;
+		bool (*guard)(Context &) = nullptr;
+		void (*action)(Context &) = nullptr;
+		/** Only run the action, no state is left or entered. */
+		bool internal = false;
+	};
+
+	/**
+	 * @brief Jump tables of a StateMachine, computed at compile time.
+	 */
+	template <const auto &states, const auto &transitions>
+	class StateTables
+	{
+	public:
+		static constexpr size_t state_count =
+			sizeof(states) / sizeof(states[0]);
+		static constexpr size_t transition_count =
+			sizeof(transitions) / sizeof(transitions[0]);
+		static constexpr int16_t none = -1;
+
+		static constexpr size_t event_count = [] {
+			size_t n = 0;
+
+			for (const auto &t : transitions)
+				if (static_cast<size_t>(t.event) >= n)
+					n = static_cast<size_t>(t.event) + 1;
+			for (const auto &st : states)
+				if (st.timeout_ms &&
+				    static_cast<size_t>(st.timeout) >= n)
+					n = static_cast<size_t>(st.timeout) + 1;
+			return n;
+		}();
+
+		static constexpr bool valid = [] {
+			for (size_t i = 0; i != state_count; i++) {
+				const auto &st = states[i];
+				size_t s = i;
+
+				if (static_cast<size_t>(st.id) != i ||
+				    static_cast<size_t>(st.parent) >= state_count ||
+				    static_cast<size_t>(st.initial) >= state_count)
+					return false;
+				if (st.initial != st.id &&
+				    states[static_cast<size_t>(st.initial)].parent !=
+				    st.id)
+					return false;
+				for (size_t d = 0; states[s].parent != states[s].id;
+				     d++) {
+					if (d == state_count)
+						return false;
+					s = static_cast<size_t>(states[s].parent);
+				}
+			}
+			for (const auto &t : transitions)
+				if (static_cast<size_t>(t.from) >= state_count ||
+				    static_cast<size_t>(t.to) >= state_count)
+					return false;
+			return true;
+		}();
+
+		static_assert(state_count < 0x7fff && transition_count < 0x7fff,
+			"Too many states or transitions");
+		static_assert(event_count != 0, "No transitions");
+		static_assert(valid, "State ids must equal their index, parent "
+			"and initial states must form a tree");
+
+		/** Parent state, none for a top level state. */
+		int16_t parent[state_count];
+		/** First transition to try for a state and event. */
+		int16_t first[state_count][event_count];
+		/** Transition to try when the guard fails. */
+		int16_t next[transition_count];
+		/** Leaf state finally entered by a transition. */
+		int16_t target[transition_count];
+		/** Deepest state not left by a transition from the first
+		 * to the second state, none for root. */
+		int16_t top[state_count][state_count];
+		/** Innermost state with a timeout containing the state. */
+		int16_t timed[state_count];
+		/** Maximum nesting of states. */
+		size_t depth;
+
+		constexpr StateTables()
+			: parent(), first(), next(), target(), top(), timed(),
+			  depth(0) {
+			int16_t own[state_count][event_count] = {};
+			int16_t same[transition_count] = {};
+
+			for (size_t i = 0; i != state_count; i++) {
+				parent[i] = states[i].parent == states[i].id ?
+					none : static_cast<int16_t>(states[i].parent);
+				for (size_t e = 0; e != event_count; e++)
+					own[i][e] = none;
+			}
+
+			for (size_t i = transition_count; i--;) {
+				size_t from = static_cast<size_t>(transitions[i].from);
+				size_t e = static_cast<size_t>(transitions[i].event);
+				same[i] = own[from][e];
+				own[from][e] = static_cast<int16_t>(i);
+			}
+
+			for (size_t i = 0; i != transition_count; i++) {
+				size_t from = static_cast<size_t>(transitions[i].from);
+				size_t e = static_cast<size_t>(transitions[i].event);
+				size_t to = static_cast<size_t>(transitions[i].to);
+
+				next[i] = same[i];
+				for (int16_t s = parent[from]; next[i] == none &&
+				     s != none; s = parent[s])
+					next[i] = own[s][e];
+				while (states[to].initial != states[to].id)
+					to = static_cast<size_t>(states[to].initial);
+				target[i] = static_cast<int16_t>(to);
+			}
+
+			for (size_t i = 0; i != state_count; i++) {
+				size_t d = Depth(static_cast<int16_t>(i)) + 1;
+				if (d > depth)
+					depth = d;
+
+				for (size_t e = 0; e != event_count; e++) {
+					first[i][e] = none;
+					for (int16_t s = static_cast<int16_t>(i);
+					     first[i][e] == none && s != none;
+					     s = parent[s])
+						first[i][e] = own[s][e];
+				}
+
+				timed[i] = none;
+				for (int16_t s = static_cast<int16_t>(i);
+				     timed[i] == none && s != none; s = parent[s])
+					if (states[s].timeout_ms)
+						timed[i] = s;
+
+				for (size_t j = 0; j != state_count; j++) {
+					int16_t a = static_cast<int16_t>(i);
+					int16_t b = static_cast<int16_t>(j);
+					int16_t l = Common(a, b);
+					top[i][j] = l == b ? parent[b] : l;
+				}
+			}
+		}
+
+		/**
+		 * @brief Amount of ancestors of a state.
+		 */
+		constexpr size_t Depth(int16_t s) const {
+			size_t d = 0;
+
+			while ((s = parent[s]) != none)
+				d++;
+			return d;
+		}
+
+		/**
+		 * @brief Deepest state containing both states, none if they
+		 * are in different top level states.
+		 */
+		constexpr int16_t Common(int16_t a, int16_t b) const {
+			size_t da = Depth(a);
+			size_t db = Depth(b);
+
+			for (; da > db; da--)
+				a = parent[a];
+			for (; db > da; db--)
+				b = parent[b];
+			while (a != b) {
+				a = parent[a];
+				b = parent[b];
+			}
+			return a;
+		}
+	};
+
+	/**
+	 * @brief Hierarchical state machine driven by a constexpr table.
+	 *
+	 * All lookups are resolved at compile time into StateTables, an
+	 * event costs one table read plus one entry per failing guard. On a
+	 * transition exit actions run from the current state up, then the
+	 * transition action, then entry actions down to the target.
+	 *
+	 * Events are either dispatched directly with Dispatch(), or posted to
+	 * the inbox and handled by Process() in the task owning the machine.
+	 * The innermost active state with timeout_ms arms a one shot Timer,
+	 * which posts its timeout event to the inbox. A timeout finding the
+	 * inbox full, or one that could not be armed because the timer
+	 * command queue stayed full, is lost and counted, see LostTimeouts().
+	 * Machines without any timeout_ms create no Timer.
+	 *
+	 * @tparam Context	Type passed to all actions and guards.
+	 * @tparam states	Static constexpr array of StateSpec, indexed
+	 *			by state.
+	 * @tparam transitions	Static constexpr array of TransitionSpec.
+	 * @tparam depth	[Optional] Inbox capacity.
+	 */
+	template <class Context, const auto &states, const auto &transitions,
+	          size_t depth = 4>
+	class StateMachine
+	{
+	public:
+		using State = decltype(states[0].id);
+		using Event = decltype(transitions[0].event);
+	protected:
+		using Tables = StateTables<states, transitions>;
+		static constexpr Tables tables {};
+		static constexpr int16_t none = Tables::none;
+
+		struct Item
+		{
+			Event event;
+			/** Nonzero for timeouts, see armed. */
+			uint32_t token;
+		};
+
+		Context &context;
+		int16_t current;
+		State initial;
+		Queue<Item, depth + 1> inbox;
+
+		static constexpr size_t FirstTimeout() {
+			for (const auto &st : states)
+				if (st.timeout_ms)
+					return st.timeout_ms;
+			return 0;
+		}
+
+		static constexpr bool timed = FirstTimeout() != 0;
+#if (configUSE_TIMERS == 1)
+		struct NoTimer
+		{
+			template <class... Args>
+			constexpr NoTimer(Args &&...) {}
+		};
+
+		/** Generation in upper bits and timed state in lower 16 bits,
+		 * changes on every arm so stale timeouts are dropped. */
+		std::atomic<uint32_t> armed {0};
+		/** Tick count of the last arm. */
+		std::atomic<TickType_t> armed_at {0};
+		/** Last token posted, only used by the timer daemon task. */
+		uint32_t posted = 0;
+		std::atomic<uint32_t> lost_timeouts {0};
+		typename std::conditional<timed, Timer, NoTimer>::type timer;
+
+		static void OnTimeout(TimerHandle_t handle) {
+			StateMachine *self = static_cast<StateMachine *>(
+				pvTimerGetTimerID(handle));
+			uint32_t token = self->armed.load(
+				std::memory_order_acquire);
+			TickType_t at = self->armed_at.load(
+				std::memory_order_relaxed);
+			int16_t s = static_cast<int16_t>(token & 0xffff);
+
+			/* An expiry sooner than the timeout after the last
+			 * arm was due before the timer got restarted */
+			if (s == none || token == self->posted ||
+			    xTaskGetTickCount() - at <
+			    pdMS_TO_TICKS(states[s].timeout_ms))
+				return;
+			self->posted = token;
+			if (!self->inbox.TryEmplaceBack(Item {
+				states[s].timeout, token }))
+				self->lost_timeouts++;
+		}
+
+		/* Leaving the timed states keeps the timer running, its
+		 * expiry finds no timed state and is ignored. */
+		void Arm(int16_t s) {
+			if constexpr (timed) {
+				uint32_t generation = (armed.load(
+					std::memory_order_relaxed) >> 16) + 1;
+				/* Generation 0 would make a token of state 0
+				 * look like a regular event */
+				uint32_t token = ((generation & 0xffff) ?
+					generation : 1) << 16;
+
+				token |= static_cast<uint16_t>(s);
+				armed_at.store(xTaskGetTickCount(),
+				               std::memory_order_relaxed);
+				armed.store(token, std::memory_order_release);
+				if (s != none && xTimerChangePeriod(
+				    timer.GetHandle(),
+				    pdMS_TO_TICKS(states[s].timeout_ms),
+				    pdMS_TO_TICKS(FREERTOS_STATE_TIMER_WAIT_MS))
+				    != pdPASS)
+					lost_timeouts++;
+			} else {
+				(void)s;
+			}
+		}
+#else /* configUSE_TIMERS */
+		static_assert(!timed, "State timeouts require configUSE_TIMERS");
+#endif /* configUSE_TIMERS */
+
+		void Enter(int16_t from, int16_t to) {
+			int16_t path[tables.depth];
+			size_t n = 0;
+
+			for (int16_t s = to; s != from; s = tables.parent[s])
+				path[n++] = s;
+			while (n--)
+				if (states[path[n]].entry)
+					states[path[n]].entry(context);
+		}
+
+		void Exit(int16_t from, int16_t to) {
+			for (int16_t s = from; s != to; s = tables.parent[s])
+				if (states[s].exit)
+					states[s].exit(context);
+		}
+	public:
+		/**
+		 * @brief Create the machine, entry actions run in Start().
+		 *
+		 * @param[in] context	Object passed to actions and guards.
+		 * @param[in] initial	First state, descends to its initial
+		 *			children.
+		 * @param[in] name	[Optional] Name of inbox and timer.
+		 */
+		StateMachine(Context &context, State initial,
+		             const char *name = nullptr)
+			: context(context), current(none), initial(initial),
+			  inbox(name)
+#if (configUSE_TIMERS == 1)
+			  , timer(OnTimeout, FirstTimeout(), false, name, this)
+#endif /* configUSE_TIMERS */
+		{}
+
+		/**
+		 * @brief Enter the initial state.
+		 */
+		void Start() {
+			int16_t s = static_cast<int16_t>(initial);
+
+			while (states[s].initial != states[s].id)
+				s = static_cast<int16_t>(states[s].initial);
+			Enter(none, s);
+			current = s;
+#if (configUSE_TIMERS == 1)
+			Arm(tables.timed[s]);
+#endif /* configUSE_TIMERS */
+		}
+
+		/**
+		 * @brief Handle an event in the calling task.
+		 *
+		 * @param[in] event	Event to handle.
+		 *
+		 * @return true if a transition was taken.
+		 */
+		bool Dispatch(Event event) {
+			size_t e = static_cast<size_t>(event);
+
+			configASSERT(current != none);
+			if (e >= Tables::event_count)
+				return false;
+			for (int16_t t = tables.first[current][e]; t != none;
+			     t = tables.next[t]) {
+				const auto &tr = transitions[t];
+
+				if (tr.guard && !tr.guard(context))
+					continue;
+				if (tr.internal) {
+					if (tr.action)
+						tr.action(context);
+					return true;
+				}
+
+				int16_t to = tables.target[t];
+				int16_t top = tables.top[current][to];
+#if (configUSE_TIMERS == 1)
+				/* Restart the timer if its state changed or was
+				 * entered again */
+				int16_t timed = tables.timed[to];
+				bool rearm = timed != tables.timed[current] ||
+					(timed != none && (top == none ||
+					 (timed != top &&
+					  tables.Common(timed, top) == top)));
+#endif /* configUSE_TIMERS */
+				Exit(current, top);
+				if (tr.action)
+					tr.action(context);
+				Enter(top, to);
+				current = to;
+#if (configUSE_TIMERS == 1)
+				if (rearm)
+					Arm(timed);
+#endif /* configUSE_TIMERS */
+				return true;
+			}
+			return false;
+		}
+
+		/**
+		 * @brief Post an event to the inbox.
+		 *
+		 * @return true if posted, false if the inbox is full.
+		 */
+		bool Post(Event event) {
+			return inbox.TryEmplaceBack(Item { event, 0 });
+		}
+
+		/**
+		 * @brief Post an event to the inbox from interrupt context.
+		 *
+		 * @param[in] event	Event to post.
+		 * @param[out] woken	[Optional] Set to pdTRUE if a context
+		 *			switch should be requested before the
+		 *			interrupt exits.
+		 *
+		 * @return true if posted, false if the inbox is full.
+		 */
+		bool PostFromISR(Event event, BaseType_t *woken = nullptr) {
+			return inbox.TryEmplaceBackFromISR(woken,
+			                                   Item { event, 0 });
+		}
+
+		/**
+		 * @brief Wait for an event from the inbox and dispatch it.
+		 *
+		 * @param[in] wait_ms	[Optional] Time to wait in [ms].
+		 *
+		 * @return true if an event was taken from the inbox, false on
+		 * timeout.
+		 */
+		bool Process(size_t wait_ms = WAIT_MAX) {
+			Item *item = inbox.Front(wait_ms);
+
+			if (!item)
+				return false;
+
+			Item copy = *item;
+			inbox.Pop();
+#if (configUSE_TIMERS == 1)
+			if (copy.token &&
+			    copy.token != armed.load(std::memory_order_acquire))
+				return true;
+#endif /* configUSE_TIMERS */
+			Dispatch(copy.event);
+			return true;
+		}
+
+		/**
+		 * @brief Get current leaf state.
+		 */
+		FREERTOS_NODISCARD
+		State Current() const {
+			return static_cast<State>(current);
+		}
+
+#if (configUSE_TIMERS == 1)
+		/**
+		 * @brief Get amount of timeouts dropped because the inbox
+		 * was full.
+		 */
+		FREERTOS_NODISCARD
+		uint32_t LostTimeouts() const {
+			return lost_timeouts.load(std::memory_order_relaxed);
+		}
+#endif /* configUSE_TIMERS */
+
+		/**
+		 * @brief Check if a state is active, i.e. it is the current
+		 * state or one of its ancestors.
+		 */
+		FREERTOS_NODISCARD
+		bool IsIn(State state) const {
+			int16_t s = static_cast<int16_t>(state);
+
+			return current != none &&
+				tables.Common(current, s) == s;
+		}
+
+		/**
+		 * @brief Prevent class to be copied.
+		 */
+		StateMachine(const StateMachine &) = delete;
+	};
+
+#if defined(__cpp_impl_coroutine) && (configUSE_QUEUE_SETS == 1) && \
+	(configSUPPORT_DYNAMIC_ALLOCATION == 1)
+	class CoroutineScheduler;
+
+	/**
+	 * @brief Return type of a coroutine run by CoroutineScheduler.
+	 *
+	 * The coroutine does not start until it is passed to
+	 * CoroutineScheduler::Spawn(). Its frame is allocated from a static
+	 * pool, see FREERTOS_COROUTINE_FRAMES.
+	 */
+	class Coroutine
+	{
+	public:
+		struct promise_type
+		{
+			CoroutineScheduler *scheduler = nullptr;
+
+			static void *operator new(size_t size) {
+				return Frames::Alloc(size);
+			}
+
+			static void operator delete(void *ptr) {
+				Frames::Free(ptr);
+			}
+
+			Coroutine get_return_object() {
+				return Coroutine(std::coroutine_handle<
+					promise_type>::from_promise(*this));
+			}
+
+			std::suspend_always initial_suspend() noexcept {
+				return {};
+			}
+
+			std::suspend_never final_suspend() noexcept {
+				return {};
+			}
+
+			void return_void() {}
+
+			void unhandled_exception() {
+				configASSERT(0);
+			}
+		};
+
+		Coroutine(Coroutine &&other)
+			: handle(other.handle) {
+			other.handle = nullptr;
+		}
+
+		~Coroutine() {
+			if (handle)
+				handle.destroy();
 		}
 
 		/**
-		 * Wait given amount ms since last call.
-		 *
-		 * @param ms Maximum waiting time in [ms].
+		 * @brief Prevent class to be copied.
 		 */
-		void Wait(size_t ms) {
-			vTaskDelayUntil(&xLastWakeTime, pdMS_TO_TICKS(ms));
-		}
+		Coroutine(const Coroutine &) = delete;
+	protected:
+		friend class CoroutineScheduler;
+		std::coroutine_handle<promise_type> handle;
+
+		explicit Coroutine(std::coroutine_handle<promise_type> h)
+			: handle(h) {}
+
+		/* Fixed size frame pool shared by all coroutines */
+		class Frames
+		{
+			static_assert(FREERTOS_COROUTINE_FRAME_SIZE %
+				alignof(std::max_align_t) == 0,
+				"Frame size must keep frames aligned");
+			union Frame
+			{
+				Frame *next;
+				alignas(std::max_align_t) uint8_t
+					data[FREERTOS_COROUTINE_FRAME_SIZE];
+			};
+			static inline Frame pool[FREERTOS_COROUTINE_FRAMES];
+			static inline Frame *free_list = nullptr;
+			static inline size_t used = 0;
+		public:
+			static void *Alloc(size_t size) {
+				Frame *f;
+
+				/* Increase FREERTOS_COROUTINE_FRAME_SIZE */
+				configASSERT(size <= sizeof(Frame));
+				vTaskSuspendAll();
+				if (free_list) {
+					f = free_list;
+					free_list = f->next;
+				} else if (used != FREERTOS_COROUTINE_FRAMES) {
+					f = &pool[used++];
+				} else {
+					f = nullptr;
+				}
+				xTaskResumeAll();
+				/* Increase FREERTOS_COROUTINE_FRAMES */
+				configASSERT(f != nullptr);
+				return f;
+			}
+
+			static void Free(void *ptr) {
+				Frame *f = static_cast<Frame *>(ptr);
+
+				vTaskSuspendAll();
+				f->next = free_list;
+				free_list = f;
+				xTaskResumeAll();
+			}
+		};
 	};
-#endif
 
 	/**
-	 * @brief Creates a new FreeRTOS queue instance.
+	 * @brief Runs many coroutines inside a single task.
 	 *
-	 * @Note This is MPSC queue (multi producers, single consumer queue).
-	 * If you need to use MPMC queue, you have to block the kernel until
-	 * popped pointer is processed or copied.
+	 * A coroutine waiting in CoDelay(), CoTake() or CoFront() is suspended
+	 * while the task keeps running the others. The task itself blocks on
+	 * a queue set holding every awaited semaphore and queue.
 	 *
-	 * @tparam T		Type of object to be enqueued.
-	 * @tparam size		Maximum queue size
-	 *			(maximum amount of object to store).
+	 * Awaited objects must only be consumed by coroutines of one
+	 * scheduler, they are added to its queue set. Mutexes can not be
+	 * awaited.
 	 */
-	template <class T, size_t size = 2>
-	class Queue
+	class CoroutineScheduler
 	{
 	protected:
+		struct Wait
+		{
+			QueueSetMemberHandle_t object = nullptr;
+			/* Extra condition checked after taking the object */
+			bool (*check)(void *ctx) = nullptr;
+			void *ctx = nullptr;
+			std::coroutine_handle<> handle;
+			TickType_t start = 0;
+			TickType_t ticks = 0;
+			bool result = false;
+			Wait *next = nullptr;
+		};
+
+		struct Member
+		{
+			QueueSetMemberHandle_t object;
+			/* Selected from the set but not taken yet */
+			size_t pending;
+		};
+
+		QueueSetHandle_t set = nullptr;
+		QueueHandle_t spawn = nullptr;
+		Wait *waits = nullptr;
+		Member members[FREERTOS_COROUTINE_OBJECTS] = {};
 #if (configSUPPORT_STATIC_ALLOCATION == 1)
-		StaticQueue_t xStaticQueue;
+		StaticQueue_t spawn_buffer;
+		uint8_t spawn_storage[4 * sizeof(void *)];
 #endif /* STATIC_ALLOCATION */
-		CountingSemaphore semaphore {0, size};
-		T buffer[size];
-		size_t rd_idx = 0;
-		size_t wr_idx = 0;
+
+		Member *Find(QueueSetMemberHandle_t object) {
+			for (Member &m : members)
+				if (m.object == object)
+					return &m;
+			return nullptr;
+		}
+
+		/* Take the object without blocking, keep it in the set if not */
+		bool TryTake(QueueSetMemberHandle_t object) {
+			Member *m = Find(object);
+
+			if (m) {
+				/* Every take must follow a select */
+				if (!m->pending)
+					return false;
+				m->pending--;
+				return xSemaphoreTake(object, 0) == pdTRUE;
+			}
+
+			if (xSemaphoreTake(object, 0) == pdTRUE)
+				return true;
+			if (xQueueAddToSet(object, set) != pdPASS) {
+				/* Given meanwhile, else it is in another set */
+				bool taken = xSemaphoreTake(object, 0) == pdTRUE;
+				configASSERT(taken);
+				return taken;
+			}
+			m = Find(nullptr);
+			/* Increase FREERTOS_COROUTINE_OBJECTS */
+			configASSERT(m != nullptr);
+			*m = { object, 0 };
+			return false;
+		}
+
+		/* Drop the object from the set when nobody waits for it */
+		void Release(QueueSetMemberHandle_t object) {
+			Member *m = Find(object);
+
+			if (!m || m->pending)
+				return;
+			for (Wait *w = waits; w; w = w->next)
+				if (w->object == object)
+					return;
+			/* Fails if not empty, it will be selected again */
+			if (xQueueRemoveFromSet(object, set) == pdPASS)
+				m->object = nullptr;
+		}
+
+		/* Returns false if the wait is already over */
+		bool Suspend(Wait *w) {
+			while (w->object && TryTake(w->object)) {
+				if (!w->check || w->check(w->ctx)) {
+					w->result = true;
+					return false;
+				}
+			}
+			if (!w->ticks) {
+				w->result = false;
+				if (w->object)
+					Release(w->object);
+				return false;
+			}
+			w->start = xTaskGetTickCount();
+			w->next = nullptr;
+			Wait **p = &waits;
+			while (*p)
+				p = &(*p)->next;
+			*p = w;
+			return true;
+		}
+
+		void Resume(Wait **p, bool result) {
+			Wait *w = *p;
+			QueueSetMemberHandle_t object = w->object;
+
+			*p = w->next;
+			w->result = result;
+			/* Frame holding w may be gone after this */
+			w->handle.resume();
+			if (object)
+				Release(object);
+		}
+
+		/* Serve first waiter of a selected object */
+		void Dispatch(QueueSetMemberHandle_t object) {
+			Member *m = Find(object);
+
+			if (!m)
+				return;
+			m->pending++;
+			for (Wait **p = &waits; *p; p = &(*p)->next) {
+				Wait *w = *p;
+				if (w->object != object)
+					continue;
+				if (!TryTake(object))
+					break;
+				if (!w->check || w->check(w->ctx))
+					Resume(p, true);
+				break;
+			}
+			Release(object);
+		}
+
+		/* Resume expired waits, return ticks until the next one */
+		TickType_t Expire() {
+			TickType_t now = xTaskGetTickCount();
+			TickType_t next = portMAX_DELAY;
+			Wait **p = &waits;
+
+			while (*p) {
+				Wait *w = *p;
+				if (w->ticks == portMAX_DELAY) {
+					p = &w->next;
+				} else if ((TickType_t)(now - w->start) >= w->ticks) {
+					Resume(p, false);
+					/* List may have changed */
+					p = &waits;
+					next = portMAX_DELAY;
+				} else {
+					TickType_t left = w->ticks - (now - w->start);
+					if (left < next)
+						next = left;
+					p = &w->next;
+				}
+			}
+			return next;
+		}
 	public:
 		/**
-		 * @brief Default constructor.
+		 * @brief Awaitable returned by CoDelay().
 		 */
-		Queue() {}
+		class DelayAwaiter
+		{
+		protected:
+			Wait wait;
+		public:
+			explicit DelayAwaiter(TickType_t ticks) {
+				wait.ticks = ticks;
+			}
+
+			bool await_ready() const noexcept {
+				return wait.ticks == 0;
+			}
+
+			bool await_suspend(std::coroutine_handle<
+				Coroutine::promise_type> h) {
+				wait.handle = h;
+				return h.promise().scheduler->Suspend(&wait);
+			}
+
+			void await_resume() const noexcept {}
+		};
 
 		/**
-		 * @brief Prevent class to be copied or moved.
-		 */
-		Queue(const Queue&) = delete;
-		Queue(Queue&&) = delete;
-
-		/**
-		 * @brief Construct an item at the back place of a queue.
-		 *
-		 * This function must not be called from an interrupt service
-		 * routine.
-		 *
-		 * @param[in] args	T constructor arguments.
-		 * @return true if item posted in the queue,
-		 * false when no space left.
+		 * @brief Awaitable returned by CoTake().
 		 */
-		template <typename... Args>
-		bool TryEmplaceBack(Args &&...args) noexcept (
-			std::is_nothrow_constructible<T, Args &&...>::value) {
-			static_assert(
-				std::is_constructible<T, Args &&...>::value,
-				"T must be constructible with Args&&...");
-
-			size_t next_wr_idx = wr_idx + 1;
-			if (next_wr_idx == size)
-				next_wr_idx = 0;
+		class TakeAwaiter
+		{
+		protected:
+			Wait wait;
+		public:
+			TakeAwaiter(Mutex &sem, TickType_t ticks) {
+				wait.object = sem.handle;
+				wait.ticks = ticks;
+			}
 
-			if (next_wr_idx == rd_idx)
+			bool await_ready() const noexcept {
 				return false;
+			}
 
-			new (&buffer[wr_idx]) T(std::forward<Args>(args)...);
-			semaphore.Give();
-			wr_idx = next_wr_idx;
-			return true;
-		}
+			bool await_suspend(std::coroutine_handle<
+				Coroutine::promise_type> h) {
+				wait.handle = h;
+				return h.promise().scheduler->Suspend(&wait);
+			}
 
-		/**
-		 * @brief Post an item to the back of a queue.
-		 *
-		 * This function must not be called from an interrupt service
-		 * routine.
-		 *
-		 * @param[in] item	Pointer to item to post.
-		 *
-		 * @return true if item posted in the queue, false when
-		 * no space left.
-		 */
-		bool TryPushBack(const T &item) noexcept {
-			return TryEmplaceBack(item);
-		}
+			bool await_resume() const noexcept {
+				return wait.result;
+			}
+		};
 
 		/**
-		 * @brief Receive an item from a queue.
-		 *
-		 * @param[in] wait_ms	[Optional] The maximum amount of time
-		 *			the task should block waiting for an
-		 *			item to appear in the queue.
-		 *
-		 * @return Pointer to item in the buffer or nullptr if queue is
-		 * empty.
+		 * @brief Awaitable returned by CoFront().
 		 */
-		T* Front(size_t wait_ms = 0) noexcept {
-			if (wr_idx == rd_idx) {
-				if (wait_ms) {
-					if (!semaphore.Take(wait_ms))
-						return nullptr;
-				} else
-					return nullptr;
+		template <class T, size_t size>
+		class FrontAwaiter
+		{
+		protected:
+			Wait wait;
+			Queue<T, size> &queue;
+
+			static bool NotEmpty(void *ctx) {
+				Queue<T, size> *q = static_cast<Queue<T, size> *>(ctx);
+				return q->Available();
+			}
+		public:
+			FrontAwaiter(Queue<T, size> &q, TickType_t ticks)
+				: queue(q) {
+				wait.object = static_cast<Mutex &>(q.semaphore).handle;
+				wait.check = NotEmpty;
+				wait.ctx = &q;
+				wait.ticks = ticks;
 			}
 
-			return &buffer[rd_idx];
-		}
+			bool await_ready() const noexcept {
+				return NotEmpty(&queue);
+			}
 
-		void Pop() noexcept {
-			static_assert(std::is_nothrow_destructible<T>::value,
-					"T must be nothrow destructible");
-			buffer[rd_idx].~T();
-			rd_idx++;
-			if (rd_idx == size)
-				rd_idx = 0;
-		}
-	};
+			bool await_suspend(std::coroutine_handle<
+				Coroutine::promise_type> h) {
+				wait.handle = h;
+				return h.promise().scheduler->Suspend(&wait);
+			}
+
+			T *await_resume() noexcept {
+				return queue.Front();
+			}
+		};
 
-#if (configUSE_TIMERS == 1)
-	/**
-	 * @brief FreeRTOS software timer.
-	 */
-	class Timer
-	{
-	protected:
-		TimerHandle_t handle = nullptr;
-#if (configSUPPORT_STATIC_ALLOCATION == 1)
-		StaticTimer_t xTimerBuffers;
-#endif
-	public:
 		/**
-		 * @brief Creates instance of software timer.
+		 * @brief Create the queue set.
 		 *
-		 * @param[in] callback		The function to call when the
-		 *				timer expires.
-		 * @param[in] period_ms		Timer expire time in [ms].
-		 * @param[in] autoreload	false to single shot, true for
-		 *				repeat.
-		 * @param[in] name		Timer name string for debugging
-		 *				purpose.
-		 * @param[in] timer_id		An identifier that is assigned
-		 *				to the timer being created.
-		 *				Typically this would be used
-		 *				in the timer callback function
-		 *				to identify which timer expired
-		 *				when the same callback function
-		 *				is assigned to more than one
-		 *				timer.
+		 * @param[in] events	Queue set length, must be at least the
+		 *			sum of lengths of all awaited objects
+		 *			plus the spawn queue depth (4).
 		 */
-		Timer(void (*callback)(TimerHandle_t handle),
-			size_t period_ms,
-			bool autoreload = true,
-			const char *name = nullptr,
-			void *timer_id = nullptr) {
+		explicit CoroutineScheduler(size_t events = 32) {
+			set = xQueueCreateSet(events);
+			configASSERT(set != nullptr);
 #if (configSUPPORT_STATIC_ALLOCATION == 1)
-			handle = xTimerCreateStatic(name,
-				pdMS_TO_TICKS(period_ms),
-				autoreload, timer_id,
-				callback, &xTimerBuffers);
+			spawn = xQueueCreateStatic(4, sizeof(void *),
+			                           spawn_storage, &spawn_buffer);
 #else /* STATIC_ALLOCATION */
-			handle = xTimerCreate(name,
-				pdMS_TO_TICKS(period_ms),
-				autoreload, timer_id,
-				callback);
+			spawn = xQueueCreate(4, sizeof(void *));
 #endif /* STATIC_ALLOCATION */
-			configASSERT(handle != nullptr);
+			configASSERT(spawn != nullptr);
+			BaseType_t added = xQueueAddToSet(spawn, set);
+			configASSERT(added == pdPASS);
+			(void)added;
 		}
 
 		/**
-		 * @brief Delete timer and release allocated memory.
+		 * @brief Start a coroutine, can be called from any task.
+		 *
+		 * @param[in] c		Coroutine to run.
+		 * @param[in] wait_ms	[Optional] Time to wait for space in
+		 *			the spawn queue.
+		 *
+		 * @return true if started, otherwise the coroutine is
+		 * destroyed.
 		 */
-		~Timer() {
-			Delete();
+		bool Spawn(Coroutine c, size_t wait_ms = WAIT_MAX) {
+			void *frame = c.handle.address();
+
+			c.handle.promise().scheduler = this;
+			if (xQueueSend(spawn, &frame,
+			               pdMS_TO_TICKS(wait_ms)) != pdPASS)
+				return false;
+			c.handle = nullptr;
+			return true;
 		}
 
 		/**
-		 * @brief Prevent class to be copied.
+		 * @brief Run coroutines forever, called from the task owning
+		 * the scheduler.
 		 */
-		Timer(const Timer &) = delete;
+		void Run() {
+			while (1) {
+				QueueSetMemberHandle_t object =
+					xQueueSelectFromSet(set, Expire());
 
-		/**
-		 * @brief Delete timer and release allocated memory.
-		 */
-		void Delete(size_t wait_ms = 0) {
-			if (handle)
-				configASSERT(xTimerDelete(handle,
-					pdMS_TO_TICKS(wait_ms)) == pdPASS);
-			handle = nullptr;
+				if (!object)
+					continue;
+				if (object == spawn) {
+					void *frame;
+					if (xQueueReceive(spawn, &frame, 0) == pdPASS)
+						std::coroutine_handle<>::from_address(
+							frame).resume();
+				} else {
+					Dispatch(object);
+				}
+			}
 		}
 
 		/**
-		 * @brief Start the timer.
-		 *
-		 * wait_ms		[Optional] Time after the timer should
-		 *			start.
+		 * @brief Prevent class to be copied.
 		 */
-		void Start(size_t wait_ms = 0) {
-			configASSERT(xTimerStart(handle,
-				pdMS_TO_TICKS(wait_ms)) == pdPASS);
-		}
+		CoroutineScheduler(const CoroutineScheduler &) = delete;
+	};
+
+	/**
+	 * @brief Suspend the calling coroutine.
+	 *
+	 * @param[in] ms	Time to wait in [ms].
+	 */
+	inline CoroutineScheduler::DelayAwaiter CoDelay(size_t ms) {
+		return CoroutineScheduler::DelayAwaiter(pdMS_TO_TICKS(ms));
+	}
+
+	/**
+	 * @brief Take a binary or counting semaphore from a coroutine.
+	 *
+	 * @param[in] sem	Semaphore to take.
+	 * @param[in] wait_ms	[Optional] Time to wait in [ms].
+	 *
+	 * @return Awaitable resulting in true if taken, false on timeout.
+	 */
+	inline CoroutineScheduler::TakeAwaiter CoTake(BinarySemaphore &sem,
+		size_t wait_ms = WAIT_MAX) {
+		return CoroutineScheduler::TakeAwaiter(sem,
+			pdMS_TO_TICKS(wait_ms));
+	}
+
+	inline CoroutineScheduler::TakeAwaiter CoTake(CountingSemaphore &sem,
+		size_t wait_ms = WAIT_MAX) {
+		return CoroutineScheduler::TakeAwaiter(sem,
+			pdMS_TO_TICKS(wait_ms));
+	}
+
+	/**
+	 * @brief Wait for an item in a Queue from a coroutine.
+	 *
+	 * @param[in] q		Queue to wait on.
+	 * @param[in] wait_ms	[Optional] Time to wait in [ms].
+	 *
+	 * @return Awaitable resulting in pointer to the item, nullptr on
+	 * timeout. Call Pop() when done.
+	 */
+	template <class T, size_t size>
+	CoroutineScheduler::FrontAwaiter<T, size> CoFront(Queue<T, size> &q,
+		size_t wait_ms = WAIT_MAX) {
+		return CoroutineScheduler::FrontAwaiter<T, size>(q,
+			pdMS_TO_TICKS(wait_ms));
+	}
 
+	/**
+	 * @brief CoroutineScheduler with its own task.
+	 *
+	 * @tparam stack_size		Stack shared by all coroutines.
+	 * @tparam events		[Optional] Queue set length.
+	 */
+	template <size_t stack_size = FREERTOS_DEFAULT_TASK_STACK_SIZE,
+	          size_t events = 32>
+	class CoroutineTask : public CoroutineScheduler
+	{
+	protected:
+		Task<stack_size> task;
+	public:
 		/**
-		 * @brief Stop the timer.
+		 * @brief Start the scheduler task.
 		 *
-		 * @param[in] wait_ms		[Optional] Specifies the time,
-		 *				in [ms], that the calling task
-		 *				should be held in the Blocked
-		 *				state to wait for the stop
-		 *				command to be successfully.
+		 * @param[in] name	[Optional] Task name string.
+		 * @param[in] priority	[Optional] Task priority.
 		 */
-
-		void Stop(size_t wait_ms = 0) {
-			configASSERT(xTimerStop(handle,
-				pdMS_TO_TICKS(wait_ms)) == pdPASS);
-		}
+		explicit CoroutineTask(const char *name = nullptr,
+			int priority = tskIDLE_PRIORITY + 1)
+			: CoroutineScheduler(events),
+			  task([this] { Run(); }, name, priority) {}
 	};
-#endif /* configUSE_TIMERS */
+#endif /* __cpp_impl_coroutine */
 }
 
 #endif /* __FREERTOS_ABSTRACT__ */
@@ -1,5 +1,6 @@
 #include "FreeRTOS.h"
 #include "FreeRTOSConfig.h"
+#include "task.h"
 
 #if (configSUPPORT_STATIC_ALLOCATION == 1)
 __attribute__((used))
@@ -21,6 +22,45 @@ void assert_failed(void)
 }
 #endif /* configASSERT */
 
+#if (FREERTOS_CONTEXT_SWITCH_COUNT == 1)
+#ifndef FREERTOS_CONTEXT_SWITCH_TLS_INDEX
+#define FREERTOS_CONTEXT_SWITCH_TLS_INDEX	(configNUM_THREAD_LOCAL_STORAGE_POINTERS - 1)
+#endif
+
+/* Add to FreeRTOSConfig.h:
+ * #define traceTASK_SWITCHED_IN() freertos_task_switched_in() */
+void freertos_task_switched_in(void)
+{
+	uintptr_t n = (uintptr_t)pvTaskGetThreadLocalStoragePointer(NULL,
+		FREERTOS_CONTEXT_SWITCH_TLS_INDEX);
+	vTaskSetThreadLocalStoragePointer(NULL,
+		FREERTOS_CONTEXT_SWITCH_TLS_INDEX, (void *)(n + 1));
+}
+#endif /* FREERTOS_CONTEXT_SWITCH_COUNT */
+
+#if (configGENERATE_RUN_TIME_STATS == 1) && (defined(__unix__) || defined(__APPLE__))
+#include <time.h>
+
+/* Run time counter for the POSIX port, add to FreeRTOSConfig.h:
+ * #define portCONFIGURE_TIMER_FOR_RUN_TIME_STATS() freertos_runtime_counter_init()
+ * #define portGET_RUN_TIME_COUNTER_VALUE() freertos_runtime_counter() */
+static struct timespec run_time_start;
+
+void freertos_runtime_counter_init(void)
+{
+	clock_gettime(CLOCK_MONOTONIC, &run_time_start);
+}
+
+unsigned long freertos_runtime_counter(void)
+{
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	/* Microseconds */
+	return (unsigned long)(now.tv_sec - run_time_start.tv_sec) * 1000000UL +
+		(now.tv_nsec - run_time_start.tv_nsec) / 1000;
+}
+#endif /* configGENERATE_RUN_TIME_STATS */
+
 void *__wrap_malloc(size_t size) {
 	return pvPortMalloc(size);
 }